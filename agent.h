@@ -16,11 +16,20 @@
 #include <algorithm>
 #include "board.h"
 #include "action.h"
+#include "rollout.h"
+#include "ucb.h"
+#include "solver.h"
+#include "prior.h"
 #include <fstream>
 #include <functional>
-#include <time.h>
+#include <chrono>
 #include <thread>
 #include <unordered_map>
+#include <memory>
+#include <limits>
+#include <mutex>
+#include <atomic>
+#include <deque>
 class agent {
 public:
 	agent(const std::string& args = "") {
@@ -36,6 +45,8 @@ public:
 	virtual void close_episode(const std::string& flag = "") {}
 	virtual action take_action(const board& b) { return action(); }
 	virtual bool check_for_win(const board& b) { return false; }
+	virtual void ponder(const board& b) {}
+	virtual void stop() {}
 
 public:
 	virtual std::string property(const std::string& key) const { return meta.at(key); }
@@ -69,15 +80,232 @@ protected:
 	std::default_random_engine engine;
 };
 
+/**
+ * xoshiro256** generator, small and fast enough to give every search thread its own
+ * the state is filled by splitmix64 from the seed, and jump() advances 2^128 steps,
+ * so that the streams of several threads split from one seed never overlap
+ */
+class xoshiro {
+public:
+	typedef uint64_t result_type;
+	explicit xoshiro(uint64_t seed = 0) { this->seed(seed); }
+
+	void seed(uint64_t seed) {
+		for (uint64_t& x : s) {
+			uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			x = z ^ (z >> 31);
+		}
+	}
+	result_type operator ()() {
+		uint64_t result = rotl(s[1] * 5, 7) * 9;
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+	void jump() {
+		static const uint64_t poly[] = { 0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull };
+		uint64_t j[4] = {};
+		for (uint64_t p : poly) {
+			for (int b = 0; b < 64; b++, (*this)()) {
+				if (!(p & (1ull << b))) continue;
+				for (int k = 0; k < 4; k++) j[k] ^= s[k];
+			}
+		}
+		std::copy(j, j + 4, s);
+	}
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return ~result_type(0); }
+
+private:
+	static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+	uint64_t s[4];
+};
+
+/**
+ * bump allocator that hands out contiguous ranges of elements from fixed-size chunks
+ * allocated elements never move, and clear() recycles all the chunks for the next use
+ * allocate() is thread-safe, and the chunk table is reserved up front so that reading is lock-free
+ */
+template<typename type, size_t chunk = 4096>
+class arena {
+public:
+	arena() : used(0) { pool.reserve((size_t(1) << 32) / chunk); }
+	arena(const arena&) = delete;
+
+	/**
+	 * allocate n (<= chunk) contiguous elements and return the index of the first one
+	 */
+	uint32_t allocate(size_t n = 1) {
+		std::lock_guard<std::mutex> guard(lock);
+		if (used % chunk + n > chunk) used += chunk - used % chunk; // a range never crosses two chunks
+		while (used + n > pool.size() * chunk) pool.emplace_back(new type[chunk]);
+		uint32_t index = used;
+		used += n;
+		return index;
+	}
+
+	type& operator [](uint32_t i) { return pool[i / chunk][i % chunk]; }
+	const type& operator [](uint32_t i) const { return pool[i / chunk][i % chunk]; }
+	size_t size() const { std::lock_guard<std::mutex> guard(lock); return used; }
+	void clear() { used = 0; }
+	void swap(arena& other) {
+		std::lock_guard<std::mutex> guard(lock);
+		pool.swap(other.pool);
+		std::swap(used, other.used);
+	}
+
+private:
+	std::vector<std::unique_ptr<type[]>> pool;
+	size_t used;
+	mutable std::mutex lock;
+};
+
+/**
+ * transposition table of the win and visit counts of positions, keyed by their zobrist hashes
+ * a position is probed in a cluster of 4 entries and claims an empty entry by CAS on its key, so the
+ * table is lock-free; a position whose cluster is full is simply not recorded
+ */
+class transposition {
+public:
+	struct entry {
+		uint64_t key;
+		uint32_t win, visit; // win counts are from the view of the side who played the last move
+	};
+
+	/**
+	 * resize the table to 2^bits (at least 4) entries, 0 disables the table
+	 */
+	void resize(size_t bits) {
+		size_t size = bits ? size_t(1) << std::max<size_t>(bits, 2) : 0;
+		if (table.size() != size) table.assign(size, entry());
+	}
+	void clear() { std::fill(table.begin(), table.end(), entry()); }
+	bool enabled() const { return table.size(); }
+
+	/**
+	 * find the entry of a position, or return nullptr if it is not recorded
+	 */
+	const entry* find(uint64_t key) const {
+		key = key ? key : 1; // key 0 marks an empty entry
+		const entry* e = &table[(key & (table.size() - 1)) & ~size_t(3)];
+		for (int k = 0; k < 4; k++) {
+			uint64_t found = __atomic_load_n(&e[k].key, __ATOMIC_ACQUIRE);
+			if (found == key) return &e[k];
+			if (found == 0) break;
+		}
+		return nullptr;
+	}
+
+	/**
+	 * find the entry of a position, or claim one for it
+	 * return nullptr if the cluster is full
+	 */
+	entry* insert(uint64_t key) {
+		key = key ? key : 1;
+		entry* e = &table[(key & (table.size() - 1)) & ~size_t(3)];
+		for (int k = 0; k < 4; k++) {
+			uint64_t found = 0;
+			if (__atomic_compare_exchange_n(&e[k].key, &found, key, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) || found == key)
+				return &e[k];
+		}
+		return nullptr;
+	}
+
+private:
+	std::vector<entry> table;
+};
+
+/**
+ * time manager for a game with a total thinking time, measured by a steady wall clock
+ * the remaining time is shared among the moves that the player may still need, estimated from its legal moves,
+ * while a small part of the total is held back for the latency between the referee and the player
+ */
+class time_manager {
+public:
+	typedef std::chrono::steady_clock clock;
+	time_manager(double total = 0) : total(total * 1000), used(0) {}
+
+	/**
+	 * restart the accounting for a new game
+	 */
+	void reset() { used = 0; }
+
+	/**
+	 * get the budget in milliseconds for the next move of who
+	 */
+	double budget(const board& state, unsigned who) const {
+		double remain = total * 0.95 - used;
+		int moves = std::max(state.legal_count(who) / 2, 4); // never expect fewer than 4 own moves
+		return std::max(remain / moves - 5, 0.0); // 5 ms for replying to the referee
+	}
+
+	/**
+	 * charge the time spent since start
+	 */
+	void charge(clock::time_point start) {
+		used += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	}
+
+	/**
+	 * charge the time spent in a scope when it ends
+	 */
+	class turn {
+	public:
+		turn(time_manager& tm) : tm(tm), start(clock::now()) {}
+		~turn() { tm.charge(start); }
+		clock::time_point since() const { return start; }
+	private:
+		time_manager& tm;
+		clock::time_point start;
+	};
+
+private:
+	double total, used; // in milliseconds
+};
+
 /**
  * player for both side
- * MCTS: perform N cycles and take the best action by visit count
+ * MCTS: perform N cycles, or search for T milliseconds, and take the best action by visit count
+ *       with tt=B, positions reached by different move orders share their statistics in a table of 2^B entries,
+ *       which also merges the symmetric positions, and with symmetry=1, the moves symmetric to others are pruned
+ *       with rave=K, the AMAF values of children are blended in until they have about K visits
+ *       with reuse=1, the subtree of the actual position is kept from the previous search,
+ *       and with ponder=1, the GTP shell keeps searching while the opponent is thinking
+ *       with nodes=M, a timed search or pondering stops once a tree holds M nodes (24 bytes each), or never with 0
+ *       with time=S, the total thinking time of a game is S seconds, and each move is given a share of
+ *       the remaining time (at most T milliseconds if T is also set)
+ *       with thread=K, parallel=root searches K separate trees and merges their root children,
+ *       while parallel=tree searches one shared tree with a virtual loss of vl per selected node
+ *       each thread draws from its own generator split from seed, so an N-cycle search is reproducible,
+ *       except for parallel=tree, which is only reproducible with deterministic=1 (see run_lockstep)
+ *       with prior=mobility, the children are expanded in the order of the prior policy (see prior.h) instead
+ *       of a random order, and with widen=W, a node with n visits only selects from its first 1 + W * sqrt(n) children
+ *       with rollout=pattern, the playouts sample the moves by the weights of their 3x3 patterns (see patterns),
+ *       which are loaded from weights=FILE if given, instead of uniformly
+ *       with solve=K, a position with at most K legal moves is first solved exactly by searching at most
+ *       solve_nodes=M nodes within half of the time of the move (see solver), and the search falls back to MCTS
+ *       unless a win is proven, while a player without N, T, or time never solves
  * random: put a legal piece randomly
  */
 class player : public random_agent {
 public:
-	player(const std::string& args = "") : random_agent("name=random role=unknown N=0 T=0 thread=0 C=1.4" + args),
-		space(board::size_x * board::size_y), who(board::empty) {
+	player(const std::string& args = "") : random_agent("name=random role=unknown N=0 T=0 time=0 thread=0 tt=18 symmetry=0 rave=0 reuse=1 ponder=0 nodes=4000000 parallel=root vl=1 deterministic=0 prior=none widen=0 rollout=random solve=16 solve_nodes=1000000 C=1.4 " + args),
+		space(board::size_x * board::size_y), who(board::empty), engines(1, xoshiro(engine())), timer(meta["time"]),
+		policy(prior::make(property("prior"))) {
+		if (property("rollout") == "pattern") {
+			std::shared_ptr<patterns> p = std::make_shared<patterns>();
+			if (meta.find("weights") != meta.end()) p->load(property("weights"));
+			sampler = p;
+		} else if (property("rollout") != "random") {
+			throw std::invalid_argument("invalid rollout: " + property("rollout"));
+		}
 		if (name().find_first_of("[]():; ") != std::string::npos)
 			throw std::invalid_argument("invalid name: " + name());
 		if (role() == "black") who = board::black;
@@ -88,154 +316,483 @@ public:
 			space[i] = action::place(i, who);
 	}
 
-	class node : board {
+	/**
+	 * MCTS tree whose nodes live in an arena that is recycled between moves, or compacted to the
+	 * subtree of the next root when the tree is reused
+	 * children of a node are reserved as one contiguous index range for all its legal moves when it is
+	 * first expanded, and are then expanded one by one in a random order, or in the order of a prior policy
+	 * with progressive widening, only the first children are selected from until the node has enough visits
+	 * nodes only keep their statistics and move, the board of a node is replayed from the root during selection
+	 *
+	 * the statistics of positions, up to symmetry, are also gathered in a transposition table, from which the exploitation of
+	 * a child is estimated when its entry has more visits than the child, so that transposed paths share what they have learned
+	 * while the reused subtree keeps its own counts; the table is restarted with each root since it never replaces entries
+	 *
+	 * nodes are proven won or lost as in MCTS-Solver: a terminal node is won by the side who played its move,
+	 * a node with a won child is lost, and a node whose children are all lost is won; a proven node is no
+	 * longer simulated but counts its proven result, and the search stops once the root is proven
+	 *
+	 * several threads may search the same tree concurrently: the counters are updated atomically, and
+	 * the nodes on a path receive a virtual loss during selection so that other threads spread out
+	 */
+	class tree {
 	public:
-		node(const board& state, node* parent = nullptr, int position = -1) : board(state),
-			win(0), visit(0), child(), pos_(position), parent(parent) {}
-		
+		struct node {
+			uint32_t win, visit; // win counts are from the view of the side who played the move
+			uint32_t amaf_win, amaf_visit; // the playouts below the parent in which the move was played later
+			uint32_t child; // index of the first child, valid once the children are reserved
+			uint8_t move, count, size; // the move played, the number of expanded and reserved children
+			uint8_t flag; // whether the children are unreserved, being reserved, or reserved, and the proof if any
+		};
+		enum node_flag {
+			unreserved = 0, reserving = 1, reserved = 2, reservation = 3,
+			won = 4, lost = 8, proven = 12, // proven for the side who played the move
+		};
+
+		/**
+		 * the per-thread part of a search, i.e., the path being visited and the board of its last node
+		 */
+		struct trail {
+			std::vector<uint32_t> path;
+			std::vector<transposition::entry*> entries; // the table entries of the boards of the nodes in the path, if recorded
+			board state;
+			std::array<board::bitboard, 2> stones; // the stones at the end of the playout
+			ucb::batch children; // the statistics of the children being selected
+		};
+
+		tree() : nodes(), spare(), cycles(0), loss(1), halted(false), capacity(-1), table(), prune(false), rave(0), policy(), widening(0), sampler() {}
+
+		/**
+		 * discard the previous search and restart from a new root state
+		 * a selected node counts as a visit with virtual_loss losses until its result is updated
+		 */
+		void reset(const board& state, uint32_t virtual_loss = 1) {
+			nodes.clear();
+			nodes[nodes.allocate()] = {};
+			root_state = state;
+			cycles = 0;
+			loss = std::max(virtual_loss, 1u);
+			table.clear();
+		}
+
 		/**
-		 * run MCTS for N cycles and retrieve the best action
+		 * move the root down to the node of a later state and keep only its subtree for the next search
+		 * the moves are found as the stones added since the root state, played alternately from the root
+		 * return false if the state cannot be reached in the tree, in which case the tree is unchanged
 		 */
-		action run_mcts(size_t N, std::default_random_engine& engine, double exploration) {
-			
-			for (size_t i = 0; i < N; i++) {
-				std::vector<node*> path = select(exploration);
-				node* leaf = path.back()->expand(engine);
-				if (leaf != path.back()) path.push_back(leaf);
-				update(path, leaf->simulate(engine));
+		bool advance(const board& state, uint32_t virtual_loss = 1) {
+			if (nodes.size() == 0) return false;
+			board::bitboard added[2];
+			for (unsigned c = board::black; c <= board::white; c++) {
+				if (root_state.stones(c) & ~state.stones(c)) return false;
+				added[c - 1] = state.stones(c) & ~root_state.stones(c);
+			}
+			uint32_t i = 0;
+			unsigned who = root_state.info().who_take_turns;
+			for (; added[0] | added[1]; who = 3u - who) {
+				const node& parent = nodes[i];
+				uint32_t k = parent.child, end = (parent.flag & reservation) == reserved ? parent.child + parent.count : k;
+				while (k < end && !(added[who - 1] & board::bit(nodes[k].move))) k++;
+				if (k == end) return false;
+				added[who - 1] &= ~board::bit(nodes[k].move);
+				i = k;
+			}
+			if (who != state.info().who_take_turns) return false;
+			compact(i);
+			root_state = state;
+			cycles = 0;
+			loss = std::max(virtual_loss, 1u);
+			table.clear();
+			return true;
+		}
+
+		/**
+		 * run MCTS until the tree has performed N cycles in total and retrieve the best action
+		 */
+		action run_mcts(size_t N, xoshiro& engine, double exploration) {
+			trail t;
+			while (cycles++ < N && !solved()) {
+				iterate(t, engine, exploration);
 			}
 			return take_action();
 		}
 		/**
-		 * run MCTS for T milliseconds and retrieve the best action
+		 * run MCTS for N cycles as if one thread per engine searched the tree in lockstep, i.e., each round
+		 * lets every thread select its path before any of them updates, so virtual losses still spread
+		 * the paths as in a concurrent search, but the result depends only on the seeds of the engines
 		 */
-		action run_mcts_t(size_t T, std::default_random_engine& engine, double exploration) {
-			double start, end;
-			start = clock();
-			end = clock();
-			int number = 0;
-			while(end - start + 10 < T) {
-				number++;
-				std::vector<node*> path = select(exploration);
-				node* leaf = path.back()->expand(engine);
-				if (leaf != path.back()) path.push_back(leaf);
-				update(path, leaf->simulate(engine));
-				end = clock();
+		action run_lockstep(size_t N, std::vector<xoshiro>& engines, double exploration) {
+			std::vector<trail> t(engines.size());
+			while (cycles < N && !solved()) {
+				size_t k = std::min(engines.size(), N - cycles);
+				for (size_t i = 0; i < k; i++)
+					descend(t[i], engines[i], exploration);
+				for (size_t i = 0; i < k; i++)
+					update(t[i], playout(t[i], engines[i]));
+				cycles += k;
+			}
+			return take_action();
+		}
+		/**
+		 * run MCTS until the deadline, until halted, or until the tree holds as many nodes as its limit,
+		 * and retrieve the best action
+		 * the clock is only read every few cycles to keep its cost out of the search, and never before the first
+		 * 16 cycles, so that the root has a child even if the deadline has passed before the search
+		 */
+		action run_mcts_t(time_manager::clock::time_point deadline, xoshiro& engine, double exploration) {
+			trail t;
+			for (size_t n = 0; n < 16 || n % 16 != 0 || (!halted && !solved() && nodes.size() < capacity && time_manager::clock::now() < deadline); n++) {
+				iterate(t, engine, exploration);
 			}
-			std::cout << "number: " << number << std::endl;
 			return take_action();
 		}
-	protected:
 
 		/**
-		 * select from the current node to a leaf node by UCB and return all of them
-		 * a leaf node can be either a node that is not fully expanded or a terminal node
+		 * pick the best action, i.e., a proven win if any, or the most visited move that is not proven lost
 		 */
-		std::vector<node*> select(double exploration) {
-			std::vector<node*> path = { this };
-			for (node* ndptr = this; ndptr->is_selectable(); path.push_back(ndptr)) {
-				int ps = -1;
-				ps *= psi;
-				ndptr = &*std::max_element(ndptr->child.begin(), ndptr->child.end(),	
-						[=](const node& lhs, const node& rhs) { return lhs.ucb_score(ps, exploration) < rhs.ucb_score(ps, exploration); });
+		action take_action() const {
+			const node& parent = nodes[0];
+			uint8_t count = load(parent.count);
+			if (count == 0) return action(); // no legal move
+			uint32_t best = parent.child;
+			for (uint32_t k = parent.child; k < parent.child + count; k++) {
+				uint8_t proof = load(nodes[k].flag) & proven, best_proof = load(nodes[best].flag) & proven;
+				if (proof == won) return action::place(nodes[k].move, root_state.info().who_take_turns);
+				if ((proof != lost) != (best_proof != lost) ? proof != lost : load(nodes[k].visit) > load(nodes[best].visit)) best = k;
 			}
-			return path;
+			return action::place(nodes[best].move, root_state.info().who_take_turns);
+		}
+
+		/**
+		 * check whether the root is proven, i.e., whether the side to move is sure to win or lose
+		 */
+		bool solved() const { return load(nodes[0].flag) & proven; }
+
+		/**
+		 * set the transposition table to 2^bits entries, or disable it with 0
+		 */
+		void resize_table(size_t bits) { table.resize(bits); }
+
+		/**
+		 * enable or disable pruning the moves that are symmetric to others
+		 */
+		void prune_symmetry(bool enable) { prune = enable; }
+
+		/**
+		 * set the equivalence parameter of RAVE, i.e., the visits at which the AMAF value still weighs half,
+		 * or disable it with 0
+		 */
+		void blend_rave(uint32_t k) { rave = k; }
+
+		/**
+		 * set the prior policy by which the children are expanded, or nullptr for a random order
+		 */
+		void order_moves(std::shared_ptr<const prior> p) { policy = p; }
+
+		/**
+		 * set the progressive widening, so that a node with n visits is only selected from its first 1 + w * sqrt(n)
+		 * children, or disable it with 0
+		 */
+		void widen(float w) { widening = w; }
+
+		/**
+		 * set the pattern policy of the playouts, or nullptr for uniformly random playouts
+		 */
+		void sample_patterns(std::shared_ptr<const patterns> p) { sampler = p; }
+
+		/**
+		 * make the running searches return soon, or allow searching again
+		 */
+		void halt(bool stop = true) { halted = stop; }
+
+		/**
+		 * stop the timed searches once the tree holds n nodes, or never with 0,
+		 * since the arena would otherwise keep growing with an endless search such as pondering
+		 */
+		void limit(size_t n) { capacity = n ? n : -1; }
+
+		const board& state() const { return root_state; }
+		const node& root() const { return nodes[0]; }
+		const node& at(uint32_t i) const { return nodes[i]; }
+
+	protected:
+
+		/**
+		 * perform one cycle of selection, expansion, simulation, and backpropagation
+		 */
+		void iterate(trail& t, xoshiro& engine, double exploration) {
+			descend(t, engine, exploration);
+			update(t, playout(t, engine));
 		}
 
 		/**
-		 * expand the current node and return the newly expanded child node
-		 * if the current node has no unexpanded move, it returns itself
+		 * simulate from the leaf node and return the winner, which is already known if the leaf is proven
 		 */
-		node* expand(std::default_random_engine& engine) {
-			board child_state = *this;
-			std::vector<int> moves = all_moves(engine);
-			auto expanded_move = std::find_if(moves.begin(), moves.end(), [&](int move) {
-				// check whether it is an unexpanded legal move
-				bool is_expanded = std::find_if(child.begin(), child.end(),
-						[&](const node& node) { return node.info().last_move.i == move; }) != child.end();
-				return is_expanded == false && child_state.place(move) == board::legal;
-			});
-			if (expanded_move == moves.end())return this; // already terminal
-			child.emplace_back(child_state, this, *expanded_move);
-			return &child.back();
+		unsigned playout(trail& t, xoshiro& engine) {
+			uint8_t proof = load(nodes[t.path.back()].flag) & proven;
+			if (proof == 0) return sampler ? sampler->simulate(t.state, engine, &t.stones) : rollout::simulate(t.state, engine, &t.stones);
+			t.stones = {{ t.state.stones(board::black), t.state.stones(board::white) }};
+			unsigned who = 3u - t.state.info().who_take_turns; // who played the move to the leaf
+			return proof == won ? who : 3u - who;
 		}
 
 		/**
-		 * simulate the current node and return the winner
+		 * select a leaf node and expand it, the path then ends at the node to be simulated
 		 */
-		unsigned simulate(std::default_random_engine& engine) {
-			board rollout = *this;
-			std::vector<int> moves = all_moves(engine);
-			while (std::find_if(moves.begin(), moves.end(),
-					[&](int move) { return rollout.place(move) == board::legal; }) != moves.end());
-			return (rollout.info().who_take_turns == board::white) ? board::black : board::white;
+		void descend(trail& t, xoshiro& engine, double exploration) {
+			select(t, exploration);
+			uint32_t leaf = expand(t, engine);
+			if (leaf != t.path.back()) {
+				t.path.push_back(leaf);
+				enter(t, leaf);
+			}
 		}
 
 		/**
-		 * update statistics for all nodes saved in the path
+		 * select from the root to a leaf node by UCB and save all of them in the path
+		 * a leaf node can be either a node that is not fully expanded or a terminal node
+		 * the moves along the path are replayed so that the state becomes the board of the leaf node
 		 */
-		void update(std::vector<node*>& path, unsigned winner) {
-			for (node* ndptr : path) {
-				ndptr->win += (winner == info().who_take_turns) ? 1 : 0;
-				ndptr->visit += 1;
+		void select(trail& t, double exploration) {
+			t.path.clear();
+			t.entries.clear();
+			t.state = root_state;
+			for (uint32_t i = 0; ; t.state.place(board::point(nodes[i].move))) {
+				t.path.push_back(i);
+				enter(t, i);
+				const node& parent = nodes[i];
+				uint8_t count = load(parent.count), flag = load(parent.flag);
+				if ((flag & reservation) != reserved || (flag & proven) || count == 0) break;
+				uint32_t width = widening ? std::min<uint32_t>(parent.size, 1 + widening * std::sqrt(float(load(parent.visit)))) : parent.size;
+				if (count < width) break; // the size is only read once the reservation is seen
+				unsigned who = t.state.info().who_take_turns;
+				t.children.clear();
+				uint32_t lost_count = 0;
+				for (uint32_t k = parent.child; k < parent.child + count; k++) {
+					const node& child = nodes[k];
+					uint32_t visit = load(child.visit);
+					uint8_t proof = load(child.flag) & proven;
+					if (proof) { // a proven child is scored as a sure win or a sure loss
+						t.children.push(proof == won ? 1u << 30 : uint32_t(-(1 << 30)), 1, std::max(visit, 1u), 0, 0);
+						lost_count += proof == lost;
+						continue;
+					}
+					const transposition::entry* e = table.enabled() ? table.find(t.state.canonical_hash(who, child.move)) : nullptr;
+					uint32_t shared = e ? load(e->visit) : 0;
+					uint32_t win = shared > visit ? load(e->win) : load(child.win), value = std::max(shared, visit);
+					t.children.push(win, value, visit, rave ? load(child.amaf_win) : 0, rave ? load(child.amaf_visit) : 0);
+				}
+				if (count < parent.size && count - lost_count < width) break; // widen instead of selecting a lost child
+				i = parent.child + ucb::select(t.children, ucb::ln(load(parent.visit)), exploration, rave);
 			}
 		}
 
 		/**
-		 * pick the best action by visit counts
+		 * add node (i), whose board is the state, to the path with a virtual loss, which its table entry also receives
 		 */
-		action take_action() const {
-			auto best = std::max_element(child.begin(), child.end(),
-					[](const node& lhs, const node& rhs) { return lhs.visit < rhs.visit; });
-			if (best == child.end()) return action(); // no legal move
-			return action::place(best->info().last_move, info().who_take_turns);
+		void enter(trail& t, uint32_t i) {
+			add(nodes[i].visit, loss);
+			t.entries.push_back(table.enabled() ? table.insert(t.state.canonical_hash()) : nullptr);
+			if (t.entries.back()) add(t.entries.back()->visit, loss);
 		}
 
-	private:
+		/**
+		 * expand the selected leaf node and return the newly expanded child node
+		 * if the node has no unexpanded move, or its children are being reserved by another thread,
+		 * it returns the leaf itself
+		 */
+		uint32_t expand(trail& t, xoshiro& engine) {
+			uint32_t i = t.path.back();
+			node& parent = nodes[i];
+			if (load(parent.flag) & proven) return i;
+			if ((load(parent.flag) & reservation) != reserved && !reserve(t, engine)) return i;
+			uint8_t k = load(parent.count);
+			do {
+				if (k == parent.size) return i; // already terminal
+			} while (!__atomic_compare_exchange_n(&parent.count, &k, k + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+			uint32_t c = parent.child + k;
+			t.state.place(board::point(nodes[c].move));
+			return c;
+		}
 
 		/**
-		 * check whether this node is a fully-expanded non-terminal node
+		 * reserve the children of the leaf node for all its legal moves in a random order, which is then
+		 * stably sorted by the scores of the prior policy if any, so that ties remain in a random order
+		 * if pruning is enabled, only one move of each class of symmetric moves is reserved
+		 * return false if another thread is reserving them
 		 */
-		bool is_selectable() const {
-			size_t num_moves = 0;
-			for (int move = 0; move < 81; move++)
-				if (board(*this).place(move) == board::legal)
-					num_moves++;
-			return child.size() == num_moves && num_moves > 0;
+		bool reserve(trail& t, xoshiro& engine) {
+			node& parent = nodes[t.path.back()];
+			uint8_t flag = unreserved;
+			if (!__atomic_compare_exchange_n(&parent.flag, &flag, reserving, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				return (flag & reservation) == reserved;
+			board::bitboard moves = t.state.legal_moves(t.state.info().who_take_turns);
+			if (prune) moves = t.state.distinct(moves);
+			uint8_t size = board::popcount(moves);
+			uint32_t child = size ? nodes.allocate(size) : 0;
+			board::bitboard rest = moves;
+			for (uint32_t k = child; rest; rest &= rest - 1, k++) {
+				nodes[k] = {};
+				nodes[k].move = board::lowest(rest);
+			}
+			for (uint32_t k = size ? size - 1 : 0; k > 0; k--) {
+				std::uniform_int_distribution<uint32_t> pick(0, k);
+				std::swap(nodes[child + k].move, nodes[child + pick(engine)].move);
+			}
+			if (policy && size) {
+				float score[board::size_x * board::size_y];
+				policy->evaluate(t.state, moves, score);
+				std::stable_sort(&nodes[child], &nodes[child] + size, [&](const node& a, const node& b) {
+					return score[a.move] > score[b.move];
+				});
+			}
+			parent.child = child;
+			parent.size = size;
+			__atomic_store_n(&parent.flag, size ? reserved : reserved | won, __ATOMIC_RELEASE); // the mover wins if no move is left
+			return true;
 		}
 
 		/**
-		 * get the ucb score of this node
+		 * update statistics for all nodes saved in the path, and remove their virtual losses
+		 * with RAVE, the children of the nodes also count the playout if their moves were played later by the same side,
+		 * which can be read from the final stones since no stone is ever removed
 		 */
-		float ucb_score(int ps, float c = std::sqrt(2)) const {
-			float exploit = float(win) / visit;
-			float explore = std::sqrt(std::log(parent->visit) / visit);
-			return exploit * ps + c * explore;
+		void update(trail& t, unsigned winner) {
+			unsigned who = 3u - root_state.info().who_take_turns; // who played the move to path[0]
+			for (size_t k = 0; k < t.path.size(); k++, who = 3u - who) {
+				node& n = nodes[t.path[k]];
+				if (winner == who) add(n.win, 1u);
+				if (loss != 1) add(n.visit, 1u - loss);
+				if (rave && (load(n.flag) & reservation) == reserved) {
+					board::bitboard played = t.stones[(3u - who) - 1];
+					for (uint32_t c = n.child; c < n.child + n.size; c++) {
+						if ((played & board::bit(nodes[c].move)) == 0) continue;
+						if (winner != who) add(nodes[c].amaf_win, 1u);
+						add(nodes[c].amaf_visit, 1u);
+					}
+				}
+				transposition::entry* e = t.entries[k];
+				if (e == nullptr) continue;
+				if (winner == who) add(e->win, 1u);
+				if (loss != 1) add(e->visit, 1u - loss);
+			}
+			for (size_t k = t.path.size() - 1; k > 0 && (load(nodes[t.path[k]].flag) & proven); k--) {
+				if (!prove(nodes[t.path[k - 1]])) break;
+			}
 		}
 
 		/**
-		 * get all moves in shuffled order
+		 * try to prove a node from its children, and return whether it is proven
 		 */
-		std::vector<int> all_moves(std::default_random_engine& engine) const {
-			std::vector<int> moves;
-			for (int move = 0; move < 81; move++) moves.push_back(move);
-			std::shuffle(moves.begin(), moves.end(), engine);
-			return moves;
+		bool prove(node& n) {
+			uint8_t flag = load(n.flag);
+			if (flag & proven) return true;
+			if ((flag & reservation) != reserved) return false;
+			bool all_lost = true;
+			for (uint32_t c = n.child; c < n.child + n.size; c++) {
+				uint8_t proof = load(nodes[c].flag) & proven;
+				if (proof == won) {
+					__atomic_fetch_or(&n.flag, uint8_t(lost), __ATOMIC_RELEASE);
+					return true;
+				}
+				all_lost &= proof == lost;
+			}
+			if (all_lost) __atomic_fetch_or(&n.flag, uint8_t(won), __ATOMIC_RELEASE);
+			return all_lost;
 		}
-		
-	public:	
-		size_t win, visit;
-		int pos_;
-		std::vector<node> child;
-		node* parent;
-		int psi = -1;
+
+		/**
+		 * copy the subtree of the node into the spare arena with the node as the new root, and swap the arenas
+		 * the children of a node remain one contiguous range, including those not yet expanded
+		 */
+		void compact(uint32_t top) {
+			spare.clear();
+			spare[spare.allocate()] = nodes[top];
+			std::vector<uint32_t> queue(1, 0);
+			for (size_t q = 0; q < queue.size(); q++) {
+				node& n = spare[queue[q]];
+				if ((n.flag & reservation) != reserved || n.size == 0) continue;
+				uint32_t child = spare.allocate(n.size);
+				for (uint32_t k = 0; k < n.size; k++) {
+					spare[child + k] = nodes[n.child + k];
+					queue.push_back(child + k);
+				}
+				n.child = child;
+			}
+			nodes.swap(spare);
+		}
+
+		template<typename type> static type load(const type& v) { return __atomic_load_n(&v, __ATOMIC_ACQUIRE); }
+		template<typename type> static void add(type& v, type d) { __atomic_fetch_add(&v, d, __ATOMIC_RELAXED); }
+
+	private:
+		arena<node> nodes, spare;
+		board root_state;
+		std::atomic<size_t> cycles;
+		uint32_t loss;
+		std::atomic<bool> halted;
+		size_t capacity;
+		transposition table;
+		bool prune;
+		uint32_t rave;
+		std::shared_ptr<const prior> policy;
+		float widening;
+		std::shared_ptr<const patterns> sampler;
 	};
 
+	virtual ~player() { stop(); }
+
+	virtual void open_episode(const std::string& flag = "") {
+		timer.reset();
+	}
+
+	/**
+	 * keep searching the state in the background until stopped, e.g., on the opponent's time,
+	 * so that the next search starts from the tree grown meanwhile
+	 */
+	virtual void ponder(const board& state) {
+		stop();
+		size_t N = meta["N"], T = meta["T"];
+		if (!int(meta["ponder"]) || !int(meta["reuse"]) || !(N || T || double(meta["time"]) > 0)) return;
+		if (state.legal_count(state.info().who_take_turns) == 0) return;
+		double C = meta["C"];
+		size_t n = std::max<size_t>(meta["thread"], 1);
+		split(n);
+		bool shared = property("parallel") == "tree";
+		std::deque<tree>& roots = forest(shared ? 1 : n, state);
+		for (size_t i = 0; i < n; i++) {
+			tree& root = roots[shared ? 0 : i];
+			pondering.push_back(std::thread(&tree::run_mcts_t, &root, time_manager::clock::time_point::max(), std::ref(engines[i]), C));
+		}
+	}
+
+	/**
+	 * stop the background search, if any
+	 */
+	virtual void stop() {
+		if (pondering.empty()) return;
+		for (tree& root : trees) root.halt();
+		for (std::thread& t : pondering) t.join();
+		for (tree& root : trees) root.halt(false);
+		pondering.clear();
+	}
+
 	virtual action take_action(const board& state) {
+		stop();
+		time_manager::turn turn(timer);
 		size_t N = meta["N"];
 		size_t T = meta["T"];
+		if (double(meta["time"]) > 0)
+			T = std::min<double>(T ? T : -1u, timer.budget(state, who));
+		auto deadline = turn.since() + std::chrono::milliseconds(T);
 		double C = meta["C"];
 		size_t thread_num = meta["thread"];
+		split(std::max<size_t>(thread_num, 1));
+		if ((N || T) && state.legal_count(who) <= int(meta["solve"])) { // the solver may take half of the time of the move
+			auto limit = T ? turn.since() + std::chrono::milliseconds(T) / 2 : time_manager::clock::time_point::max();
+			int move;
+			if (endgame.solve(state, meta["solve_nodes"], &move, limit) == solver::win) return action::place(move, who);
+		}
 		// auto opponent_type = who == board::black ? board::white: board::black;
 		// int opponent_number = 0;
 		// for(size_t i=0; i < 9;i++)
@@ -248,105 +805,148 @@ public:
 		// else if(opponent_number < 30)T = T * 1;
 		// else T = T * 0.6;
 		
-		
-		if (N){
-			if(thread_num){
-				
-				std::vector<std::thread> t;
-				std::vector<node> roots(thread_num, state);
-				for(size_t i=0; i < thread_num; i++)
-					t.push_back(std::thread(&node::run_mcts, &roots[i], N, std::ref(engine), C));
-				
-				for(size_t j=0; j < thread_num; j++)
-					t[j].join();
-				
-				std::unordered_map<int, std::pair<int,int>> cal;
-				for(size_t i=0; i < thread_num; i++){
-					for(size_t j=0; j < roots[i].child.size(); j++){
-						int index = roots[i].child[j].pos_;
-						if(cal.find(index) == cal.end()) {
-							cal[index].first = roots[i].child[j].win;
-							cal[index].second = roots[i].child[j].visit;
-						}else
-						{
-							cal[index].first += roots[i].child[j].win;
-							cal[index].second += roots[i].child[j].visit;
-						}
-					}
-				}
-				auto best = cal.begin();
-				if(best != cal.end()){
-					
-					for(auto i = cal.begin(); i != cal.end(); i++){
-						if(best->second.second < i->second.second){
-							best = i;
-						}
-						// float mean = i->second.second ? i->second.first / i->second.second : i->second.first;
-						// float b_mean = best->second.second ? best->second.first / best->second.second : best->first;
-						// if(mean > b_mean){
-						// 	best = i;
-						// }
-					}
-					return action::place(best->first, this->who);
-				}
-			}
-			else
-				return node(state).run_mcts(N, engine, C);
-		} 
-		if (T){
-			if(thread_num){
-				
-				std::vector<std::thread> t;
-				std::vector<node> roots(thread_num, state);
-				
-				for(size_t i=0; i < thread_num; i++)
-					t.push_back(std::thread(&node::run_mcts_t, &roots[i], T, std::ref(engine), C));
-				
-				for(size_t j=0; j < thread_num; j++)
-					t[j].join();
-				std::unordered_map<int, std::pair<int,int>> cal;
-				for(size_t i=0; i < thread_num; i++){
-					for(size_t j=0; j < roots[i].child.size(); j++){
-						int index = roots[i].child[j].pos_;
-						if(cal.find(index) == cal.end()) {
-							cal[index].first = roots[i].child[j].win;
-							cal[index].second = roots[i].child[j].visit;
-						}else
-						{
-							cal[index].first += roots[i].child[j].win;
-							cal[index].second += roots[i].child[j].visit;
-						}
-					}
-				}
-				auto best = cal.begin();
-				if(best != cal.end()){
-					
-					for(auto i = cal.begin(); i != cal.end(); i++){
-						// if(best->second.second < i->second.second){
-						// 	best = i;
-						// }
-						float mean = i->second.second ? i->second.first / i->second.second : i->second.second;
-						float b_mean = best->second.second ? best->second.first / best->second.second : best->second.second;
-						if(mean > b_mean){
-							best = i;
-						}
-					}
-					return action::place(best->first, this->who);
-				}
-			}
-			else
-				return node(state).run_mcts_t(T, engine, C);
-		} 
+		if (N || T) { // a random move is taken instead if the search leaves no move at the root
+			action move = search(state, N, deadline, C, thread_num);
+			if (move.type() == action::place::type) return move;
+		}
 		std::shuffle(space.begin(), space.end(), engine);
 		for (const action::place& move : space) {
-			board after = state;
-			if (move.apply(after) == board::legal)
+			if (state.check_place(move.position(), move.color()) == board::legal)
 				return move;
 		}
 		return action();
 	}
 
+	/**
+	 * get the root visit counts of the moves in the last search of the state, summed over the trees
+	 * with symmetry=1, the visits of a move are spread evenly over the moves symmetric to it, which were pruned
+	 * return false if the state was not searched, e.g., if its move was solved exactly or taken randomly
+	 */
+	bool visits(const board& state, std::array<uint32_t, board::size_x * board::size_y>& count) const {
+		count.fill(0);
+		bool searched = false;
+		for (const tree& root : trees) {
+			if (!(root.state() == state) || root.state().info().who_take_turns != state.info().who_take_turns) continue;
+			const tree::node& parent = root.root();
+			for (uint32_t k = parent.child; k < parent.child + parent.count; k++)
+				count[root.at(k).move] += root.at(k).visit;
+			searched = true;
+		}
+		unsigned mask = state.symmetries();
+		if (!searched || mask == 1 || !std::stoi(property("symmetry"))) return searched;
+		std::array<uint32_t, board::size_x * board::size_y> spread = {};
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			if (count[i] == 0) continue;
+			int moves[8], n = 0;
+			for (int s = 0; s < 8; s++) {
+				int j = board::transform(s, i);
+				if ((mask & (1u << s)) && std::find(moves, moves + n, j) == moves + n) moves[n++] = j;
+			}
+			for (int k = 0; k < n; k++) spread[moves[k]] += count[i] / n + (uint32_t(k) < count[i] % n);
+		}
+		count = spread;
+		return searched;
+	}
+
+protected:
+	/**
+	 * search the state by N cycles, or until the deadline if N is 0, with the configured threads and parallelism
+	 */
+	action search(const board& state, size_t N, time_manager::clock::time_point deadline, double C, size_t thread_num) {
+		if (thread_num && property("parallel") == "tree") {
+			tree& root = forest(1, state)[0];
+			if (N && int(meta["deterministic"]))
+				return root.run_lockstep(N, engines, C);
+			std::vector<std::thread> t;
+			for (size_t i = 0; i < thread_num; i++) {
+				if (N) t.push_back(std::thread(&tree::run_mcts, &root, N, std::ref(engines[i]), C));
+				else   t.push_back(std::thread(&tree::run_mcts_t, &root, deadline, std::ref(engines[i]), C));
+			}
+			for (size_t j = 0; j < thread_num; j++)
+				t[j].join();
+			return root.take_action();
+		}
+		if (thread_num) { // root parallel
+			std::vector<std::thread> t;
+			std::deque<tree>& roots = forest(thread_num, state);
+			for (size_t i = 0; i < thread_num; i++) {
+				if (N) t.push_back(std::thread(&tree::run_mcts, &roots[i], N, std::ref(engines[i]), C));
+				else   t.push_back(std::thread(&tree::run_mcts_t, &roots[i], deadline, std::ref(engines[i]), C));
+			}
+			for (size_t j = 0; j < thread_num; j++)
+				t[j].join();
+			return merge(roots, thread_num);
+		}
+		if (N)
+			return forest(1, state)[0].run_mcts(N, engines[0], C);
+		return forest(1, state)[0].run_mcts_t(deadline, engines[0], C);
+	}
+
+	/**
+	 * merge the root children of the first n trees searched separately, i.e., take a proven root of any tree,
+	 * or the move with the most visits summed over the trees among those not proven lost in any tree
+	 */
+	action merge(const std::deque<tree>& roots, size_t n) const {
+		for (size_t i = 0; i < n; i++) // a proven root needs no merging
+			if (roots[i].solved()) return roots[i].take_action();
+		std::array<uint64_t, board::size_x * board::size_y> visit = {};
+		board::bitboard searched = 0, lost = 0;
+		for (size_t i = 0; i < n; i++) {
+			const tree::node& parent = roots[i].root();
+			for (uint32_t k = parent.child; k < parent.child + parent.count; k++) {
+				const tree::node& child = roots[i].at(k);
+				visit[child.move] += child.visit;
+				searched |= board::bit(child.move);
+				if ((child.flag & tree::proven) == tree::lost) lost |= board::bit(child.move);
+			}
+		}
+		if (searched & ~lost) searched &= ~lost;
+		if (searched == 0) return action();
+		int best = board::lowest(searched);
+		for (board::bitboard rest = searched; rest; rest &= rest - 1)
+			if (visit[board::lowest(rest)] > visit[best]) best = board::lowest(rest);
+		return action::place(best, who);
+	}
+
+	/**
+	 * keep one generator per thread, each new one continues 2^128 steps after the previous one
+	 */
+	void split(size_t n) {
+		while (engines.size() < n) {
+			engines.push_back(engines.back());
+			engines.back().jump();
+		}
+		engines.resize(n);
+	}
+
+	/**
+	 * get n search trees rooted at the state, the trees are kept to reuse their arenas,
+	 * and also their subtrees of the state if reuse is enabled
+	 */
+	std::deque<tree>& forest(size_t n, const board& state) {
+		while (trees.size() < n) trees.emplace_back();
+		for (size_t i = 0; i < n; i++) {
+			trees[i].resize_table(meta["tt"]);
+			trees[i].prune_symmetry(int(meta["symmetry"]));
+			trees[i].blend_rave(meta["rave"]);
+			trees[i].order_moves(policy);
+			trees[i].widen(meta["widen"]);
+			trees[i].limit(meta["nodes"]);
+			trees[i].sample_patterns(sampler);
+			if (int(meta["reuse"]) && trees[i].advance(state, meta["vl"])) continue;
+			trees[i].reset(state, meta["vl"]);
+		}
+		return trees;
+	}
+
 private:
 	std::vector<action::place> space;
 	board::piece_type who;
+	std::deque<tree> trees;
+	std::vector<std::thread> pondering;
+	std::vector<xoshiro> engines;
+	time_manager timer;
+	solver endgame;
+	std::shared_ptr<const prior> policy;
+	std::shared_ptr<const patterns> sampler;
 };
@@ -0,0 +1,237 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * bench.cpp: Benchmarks for the hot paths of the framework
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include "board.h"
+#include "ucb.h"
+#include "rollout.h"
+#include "agent.h"
+
+/**
+ * whether the results are printed as JSON lines, e.g., {"name":"rollout.random.empty","reps":50000,"ns":6123.4,"rate":163307.2},
+ * where ns is the average time of a run in nanoseconds and rate is the runs per second, instead of a table
+ */
+static bool json = false;
+
+/**
+ * print the result of reps runs that took elapsed nanoseconds in total
+ */
+void report(const std::string& name, size_t reps, double elapsed) {
+	double ns = elapsed / reps, rate = 1e9 / ns;
+	if (json) {
+		std::cout << std::fixed << std::setprecision(1) << "{\"name\":\"" << name << "\",\"reps\":" << reps
+		          << ",\"ns\":" << ns << ",\"rate\":" << rate << "}" << std::endl;
+	} else {
+		std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+		          << std::setw(14) << ns << " ns" << std::setw(14) << rate << " /s" << std::endl;
+	}
+}
+
+/**
+ * run fn for reps times and print the average time of a run in nanoseconds
+ * fn returns a value that is accumulated so that its work cannot be optimized away
+ */
+static volatile long sink;
+template<typename function>
+void measure(const std::string& name, size_t reps, function fn) {
+	auto start = std::chrono::steady_clock::now();
+	long sum = 0;
+	for (size_t i = 0; i < reps; i++) sum += fn(i);
+	report(name, reps, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+	sink = sum;
+}
+
+/**
+ * UCB selection over a node with all 81 children, where the visit counts of the children and of the parent
+ * are small enough to be looked up, or too large for the tables
+ */
+void bench_ucb(size_t reps, uint32_t scale) {
+	std::default_random_engine engine(1);
+	const int size = board::size_x * board::size_y;
+	std::vector<uint32_t> win(size), visit(size);
+	uint32_t total = 0;
+	for (int i = 0; i < size; i++) {
+		visit[i] = 1 + engine() % scale;
+		win[i] = engine() % visit[i];
+		total += visit[i];
+	}
+	std::string suffix = scale < UCB_TABLE_SIZE ? ".small" : ".large";
+
+	measure("ucb.exact" + suffix, reps, [&](size_t r) {
+		float log_visit = std::log(float(total + (r & 7))), best = -std::numeric_limits<float>::max();
+		int pick = 0;
+		for (int i = 0; i < size; i++) {
+			float score = float(win[i]) / visit[i] + 1.4f * std::sqrt(log_visit / visit[i]);
+			if (score > best) best = score, pick = i;
+		}
+		return pick;
+	});
+	measure("ucb.table" + suffix, reps, [&](size_t r) {
+		float root = std::sqrt(ucb::ln(total + (r & 7))), best = -std::numeric_limits<float>::max();
+		int pick = 0;
+		for (int i = 0; i < size; i++) {
+			float score = float(win[i]) / visit[i] + 1.4f * (root * ucb::rsqrt(visit[i]));
+			if (score > best) best = score, pick = i;
+		}
+		return pick;
+	});
+	ucb::batch batch;
+	measure("ucb.kernel" + suffix, reps, [&](size_t r) {
+		batch.clear();
+		for (int i = 0; i < size; i++) batch.push(win[i], visit[i], visit[i], 0, 0);
+		return ucb::select(batch, ucb::ln(total + (r & 7)), 1.4f, 0);
+	});
+}
+
+/**
+ * get the positions after the given number of random moves from the empty board, from fixed seeds
+ * a game that ends earlier is replaced by another one
+ */
+std::vector<board> positions(size_t count, int moves) {
+	xoshiro engine(1);
+	std::vector<board> states;
+	while (states.size() < count) {
+		board state;
+		int n = 0;
+		for (; n < moves && state.legal_moves(state.info().who_take_turns); n++) {
+			board::bitboard legal = state.legal_moves(state.info().who_take_turns);
+			state.place(board::point(board::nth(legal, engine() % board::popcount(legal))));
+		}
+		if (n == moves && state.legal_moves(state.info().who_take_turns)) states.push_back(state);
+	}
+	return states;
+}
+
+/**
+ * board operations on mid-game positions, i.e., placing a legal move (including copying the board), and
+ * checking the liberties of all stones
+ */
+void bench_board(size_t reps) {
+	std::vector<board> states = positions(1024, 30);
+	std::vector<int> moves;
+	xoshiro engine(2);
+	for (const board& state : states) {
+		board::bitboard legal = state.legal_moves(state.info().who_take_turns);
+		moves.push_back(board::nth(legal, engine() % board::popcount(legal)));
+	}
+	measure("board.place", reps, [&](size_t r) {
+		board state = states[r % states.size()];
+		return state.place(board::point(moves[r % states.size()]));
+	});
+	measure("board.check_liberty", reps / 10, [&](size_t r) {
+		const board& state = states[r % states.size()];
+		int sum = 0;
+		for (int x = 0; x < board::size_x; x++) {
+			for (int y = 0; y < board::size_y; y++) {
+				unsigned who = state[x][y];
+				if (who == board::black || who == board::white) sum += state.check_liberty(x, y, who);
+			}
+		}
+		return sum;
+	});
+}
+
+/**
+ * full playouts from the empty board and from mid-game positions, by the uniform and the pattern policies
+ */
+void bench_rollout(size_t reps) {
+	std::vector<board> empty(1), middle = positions(1024, 30);
+	patterns sampler;
+	for (const std::vector<board>* states : { &empty, &middle }) {
+		std::string suffix = states == &empty ? ".empty" : ".midgame";
+		xoshiro engine(3);
+		measure("rollout.random" + suffix, reps, [&](size_t r) {
+			return rollout::simulate((*states)[r % states->size()], engine);
+		});
+		engine = xoshiro(3);
+		measure("rollout.pattern" + suffix, reps, [&](size_t r) {
+			return sampler.simulate((*states)[r % states->size()], engine);
+		});
+	}
+}
+
+/**
+ * MCTS tree whose selection and expansion can be run alone
+ */
+class probe : public player::tree {
+public:
+	using player::tree::descend;
+};
+
+/**
+ * selection and expansion of MCTS without playouts, i.e., the path is replayed from the root and a new child is
+ * expanded at its end, where the tree is restarted every 1000 runs to bound its size
+ */
+void bench_expand(size_t reps) {
+	std::vector<board> states = positions(16, 10);
+	probe root;
+	probe::trail t;
+	xoshiro engine(4);
+	measure("mcts.descend", reps, [&](size_t r) {
+		if (r % 1000 == 0) root.reset(states[r / 1000 % states.size()]);
+		root.descend(t, engine, 1.4);
+		return int(t.path.size());
+	});
+}
+
+/**
+ * full searches of N cycles from the empty board with 1 to the given number of threads sharing one tree,
+ * where a run is a cycle, i.e., the rate is cycles per second
+ */
+void bench_search(size_t N, size_t threads, size_t reps) {
+	for (size_t k = 1; k <= threads; k++) {
+		std::string args = "role=black seed=5 reuse=0 solve=0 N=" + std::to_string(N);
+		if (k > 1) args += " parallel=tree thread=" + std::to_string(k);
+		player search(args);
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < reps; i++) search.take_action(board());
+		double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		report("mcts.search.N" + std::to_string(N) + ".t" + std::to_string(k), reps * N, elapsed);
+	}
+}
+
+int main(int argc, const char* argv[]) {
+	size_t reps = 1000000;
+	size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::string only;
+	for (int i = 1; i < argc; i++) {
+		std::string para(argv[i]);
+		if (para.find("--reps=") == 0) {
+			reps = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--threads=") == 0) {
+			threads = std::max<size_t>(std::stoull(para.substr(para.find("=") + 1)), 1);
+		} else if (para.find("--only=") == 0) {
+			only = para.substr(para.find("=") + 1);
+		} else if (para.find("--json") == 0) {
+			json = true;
+		}
+	}
+	auto enabled = [&](const std::string& group) { return only.empty() || only == group; };
+
+	if (enabled("ucb")) {
+		bench_ucb(reps, 32);
+		bench_ucb(reps, 100000);
+	}
+	if (enabled("board")) bench_board(reps);
+	if (enabled("rollout")) bench_rollout(std::max<size_t>(reps / 20, 1));
+	if (enabled("mcts")) {
+		bench_expand(std::max<size_t>(reps / 10, 1));
+		bench_search(10000, threads, 3);
+		bench_search(100000, threads, 1);
+	}
+	return 0;
+}
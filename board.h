@@ -15,6 +15,10 @@
 #include <algorithm>
 #include <utility>
 #include <cmath>
+#include <cstdint>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
 
 /**
  * definition for the 9x9 board
@@ -72,24 +76,154 @@ public:
 	};
 	typedef int reward;
 
+	/**
+	 * bitboard of the 9x9 board, bit (i) is set if point (i) is marked
+	 * i.e., bit 0 == "A1", bit 9 == "B1", ..., bit 80 == "J9"
+	 */
+	typedef __uint128_t bitboard;
+
+	/**
+	 * reference to a cell, reading it returns the piece type and assigning it puts (or removes) a piece
+	 */
+	class cell_ref {
+	public:
+		cell_ref(board& b, int i) : b(b), i(i) {}
+		operator cell() const { return b.at(i); }
+		cell_ref& operator =(cell c) { b.set(i, c); return *this; }
+		cell_ref& operator =(const cell_ref& c) { return operator =(cell(c)); }
+	private:
+		board& b;
+		int i;
+	};
+	class column_ref {
+	public:
+		column_ref(board& b, unsigned x) : b(b), x(x) {}
+		cell_ref operator [](unsigned y) const { return cell_ref(b, x * size_y + y); }
+	private:
+		board& b;
+		unsigned x;
+	};
+	class const_column_ref {
+	public:
+		const_column_ref(const board& b, unsigned x) : b(b), x(x) {}
+		cell operator [](unsigned y) const { return b.at(x * size_y + y); }
+	private:
+		const board& b;
+		unsigned x;
+	};
+
 public:
-	board() : stone(initial()), attr({piece_type::black, -1}) {}
-	board(const grid& b, const data& d) : stone(b), attr(d) {}
-	board(const board& b) = default;
-	board& operator =(const board& b) = default;
-
-	operator grid&() { return stone; }
-	operator const grid&() const { return stone; }
-	column& operator [](unsigned x) { return stone[x]; }
-	const column& operator [](unsigned x) const { return stone[x]; }
-	cell& operator ()(unsigned i) { point p(i); return stone[p.x][p.y]; }
-	const cell& operator ()(unsigned i) const { point p(i); return stone[p.x][p.y]; }
-	cell& operator ()(const std::string& move) { point p(move); return stone[p.x][p.y]; }
-	const cell& operator ()(const std::string& move) const { point p(move); return stone[p.x][p.y]; }
+	board() : stone(), atari(), moves({playable(), playable()}), key(), attr({piece_type::black, -1}), group(), count(0), blocks() {}
+	board(const grid& b, const data& d) : stone(), atari(), moves(), key(), attr(d), group(), count(0), blocks() { assign(b); }
+	board(const board& b) { *this = b; }
+	board& operator =(const board& b) {
+		stone = b.stone;
+		atari = b.atari;
+		moves = b.moves;
+		key = b.key;
+		attr = b.attr;
+		group = b.group;
+		count = b.count;
+		std::copy_n(b.blocks.begin(), b.count, blocks.begin()); // only the blocks in use
+		return *this;
+	}
+
+	operator grid() const {
+		grid g;
+		for (int i = 0; i < size_x * size_y; i++) g[i / size_y][i % size_y] = at(i);
+		return g;
+	}
+	column_ref operator [](unsigned x) { return column_ref(*this, x); }
+	const_column_ref operator [](unsigned x) const { return const_column_ref(*this, x); }
+	cell_ref operator ()(unsigned i) { return cell_ref(*this, i); }
+	cell operator ()(unsigned i) const { return at(i); }
+	cell_ref operator ()(const std::string& move) { return cell_ref(*this, point(move).i); }
+	cell operator ()(const std::string& move) const { return at(point(move).i); }
+
+	/**
+	 * get the stones of a specific side as a bitboard
+	 */
+	bitboard stones(unsigned who) const { return stone[who - 1]; }
+	bitboard empties() const { return playable() & ~(stone[0] | stone[1]); }
+
+	/**
+	 * get the 3x3 pattern around point (i), which packs the 2-bit piece types of its 8 neighbors, where a point
+	 * beyond the edge counts as hollow, and neighbor (x + dx, y + dy) is at bits 2k for k = 3(dx + 1) + (dy + 1)
+	 * except that k is one less after the center, i.e., the opposite neighbor of slot k is at slot 7 - k
+	 * the neighbors of each side are gathered from the window of its stones around point (i)
+	 */
+	uint16_t pattern(int i) const {
+		static const std::array<uint16_t, 256> spread = ([]() { // bit k to bit 2k
+			std::array<uint16_t, 256> table;
+			for (int n = 0; n < 256; n++) {
+				table[n] = 0;
+				for (int k = 0; k < 8; k++) table[n] |= ((n >> k) & 1) << (2 * k);
+			}
+			return table;
+		})();
+		static const std::array<uint8_t, size_x * size_y> inside = ([]() { // the slots within the board
+			std::array<uint8_t, size_x * size_y> table;
+			for (int i = 0; i < size_x * size_y; i++) {
+				table[i] = 0;
+				for (int k = 0; k < 8; k++) table[i] |= (around(i)[k] != -1) << k;
+			}
+			return table;
+		})();
+		uint16_t code = blank()[i];
+		for (int c = 0; c < 2; c++) {
+			bitboard w = i > size_y ? stone[c] >> (i - size_y - 1) : stone[c] << (size_y + 1 - i);
+			uint32_t b = uint32_t(w) & ((1u << (2 * size_y + 3)) - 1);
+			b = (b & 7) | ((b >> (size_y - 3)) & 8) | ((b >> (size_y - 2)) & 16) | ((b >> (2 * size_y - 5)) & 0xe0);
+			code |= spread[b & inside[i]] << c;
+		}
+		return code;
+	}
 
 	data info() const { return attr; }
 	data info(data dat) { data old = attr; attr = dat; return old; }
 
+	/**
+	 * get the zobrist hash of the position, i.e., of the stones and the side to move
+	 * the canonical hash is the least hash among the 8 symmetric positions, so they all share it
+	 */
+	uint64_t hash() const { return key[0] ^ turn(attr.who_take_turns); }
+	uint64_t canonical_hash() const { return *std::min_element(key.begin(), key.end()) ^ turn(attr.who_take_turns); }
+
+	/**
+	 * get the canonical hash of the position after who places a stone at (i), without placing it
+	 */
+	uint64_t canonical_hash(unsigned who, int i) const {
+		const std::array<uint64_t, 8>& z = zobrist(who, i);
+		uint64_t h = key[0] ^ z[0];
+		for (int s = 1; s < 8; s++) h = std::min(h, key[s] ^ z[s]);
+		return h ^ turn(3u - who);
+	}
+
+	/**
+	 * get the symmetries of the position, i.e., the mask of the transforms (s) that leave it unchanged
+	 */
+	unsigned symmetries() const {
+		unsigned mask = 1;
+		for (int s = 1; s < 8; s++) mask |= unsigned(key[s] == key[0]) << s;
+		return mask;
+	}
+
+	/**
+	 * keep only the lowest move of each class of moves that are equivalent under the symmetries
+	 */
+	bitboard distinct(bitboard moves) const {
+		unsigned mask = symmetries();
+		if (mask == 1) return moves;
+		for (bitboard rest = moves; rest; rest &= rest - 1) {
+			int i = lowest(rest);
+			if ((moves & bit(i)) == 0) continue; // equivalent to a lower move
+			for (int s = 1; s < 8; s++) {
+				if (mask & (1u << s)) moves &= ~bit(transform(s, i)) | bit(i);
+			}
+		}
+		return moves;
+	}
+
 public:
 	bool operator ==(const board& b) const { return stone == b.stone; }
 	bool operator < (const board& b) const { return stone <  b.stone; }
@@ -115,22 +249,23 @@ public:
 	 * return nogo_move_result::legal if the action is valid, or nogo_move_result::illegal_* if not
 	 */
 	reward place(int x, int y, unsigned who = piece_type::unknown) {
+		reward result = check_place(x, y, who);
+		if (result != nogo_move_result::legal) return result;
 		if (who == -1u) who = attr.who_take_turns;
-		if (who != attr.who_take_turns) return nogo_move_result::illegal_turn;
-		if (x == -1 && y == -1) return nogo_move_result::illegal_pass;
-		point p_min(0, 0), p_max(size_x - 1, size_y - 1);
-		if (x < p_min.x || x > p_max.x || y < p_min.y || y > p_max.y) return nogo_move_result::illegal_out_of_range;
-		if (board::initial()[x][y] == piece_type::hollow)             return nogo_move_result::illegal_out_of_range;
-		board test = *this;
-		if (test[x][y] != piece_type::empty) return nogo_move_result::illegal_not_empty;
-		test[x][y] = who; // try put a piece first
-		if (test.check_liberty(x, y, who) == 0) return nogo_move_result::illegal_suicide;
+		int i = x * size_y + y;
 		unsigned opp = 3u - who;
-		if (x > p_min.x && test.check_liberty(x - 1, y, opp) == 0) return nogo_move_result::illegal_take;
-		if (x < p_max.x && test.check_liberty(x + 1, y, opp) == 0) return nogo_move_result::illegal_take;
-		if (y > p_min.y && test.check_liberty(x, y - 1, opp) == 0) return nogo_move_result::illegal_take;
-		if (y < p_max.y && test.check_liberty(x, y + 1, opp) == 0) return nogo_move_result::illegal_take;
-		stone[x][y] = who; // is legal move!
+		stone[who - 1] |= bit(i); // is legal move!
+		const std::array<uint64_t, 8>& z = zobrist(who, i);
+		for (int s = 0; s < 8; s++) key[s] ^= z[s];
+		bitboard own = blocks[join(i, who)];
+		atari[who - 1] &= ~own;
+		if (single(liberties(own))) atari[who - 1] |= own;
+		for (bitboard near = adjacent(i) & stone[opp - 1] & ~atari[opp - 1]; near; ) { // only lose the liberty (i)
+			bitboard blk = blocks[group[lowest(near)]];
+			if (single(liberties(blk))) atari[opp - 1] |= blk;
+			near &= ~blk;
+		}
+		update_legal();
 		attr.who_take_turns = static_cast<piece_type>(opp);
 		attr.last_move = point(x, y);
 		return nogo_move_result::legal;
@@ -140,62 +275,71 @@ public:
 	}
 
 	/**
-	 * calculate the liberty of the block of piece at [x][y]
-	 * return >= 0 if [x][y] is placed by who; otherwise return -1
+	 * check whether a stone can be placed to the specific position, without modifying the board
+	 * return the same result as place()
 	 */
-	int check_liberty(int x, int y, unsigned who) const {
-		grid test = stone;
-		if (test[x][y] != who) return -1;
-
-		int liberty = 0;
-		std::list<point> check;
-		for (check.emplace_back(x, y); check.size(); check.pop_front()) {
-			int x = check.front().x, y = check.front().y;
-			test[x][y] = piece_type::unknown; // prevent recalculate
-
-			point p_min(0, 0), p_max(size_x - 1, size_y - 1);
-
-			cell near_l = x > p_min.x ? test[x - 1][y] : -1u; // left
-			if (near_l == piece_type::empty) liberty++;
-			else if (near_l == who) check.emplace_back(x - 1, y);
-
-			cell near_r = x < p_max.x ? test[x + 1][y] : -1u; // right
-			if (near_r == piece_type::empty) liberty++;
-			else if (near_r == who) check.emplace_back(x + 1, y);
+	reward check_place(int x, int y, unsigned who = piece_type::unknown) const {
+		if (who == -1u) who = attr.who_take_turns;
+		if (who != attr.who_take_turns) return nogo_move_result::illegal_turn;
+		if (x == -1 && y == -1) return nogo_move_result::illegal_pass;
+		point p_min(0, 0), p_max(size_x - 1, size_y - 1);
+		if (x < p_min.x || x > p_max.x || y < p_min.y || y > p_max.y) return nogo_move_result::illegal_out_of_range;
+		bitboard p = bit(x * size_y + y);
+		if (p & hollows())                      return nogo_move_result::illegal_out_of_range;
+		if (p & (stone[0] | stone[1]))          return nogo_move_result::illegal_not_empty;
+		if (p & moves[who - 1])                 return nogo_move_result::legal;
+		return legality(x * size_y + y, who);
+	}
+	reward check_place(const point& p, unsigned who = piece_type::unknown) const {
+		return check_place(p.x, p.y, who);
+	}
 
-			cell near_d = y > p_min.y ? test[x][y - 1] : -1u; // down
-			if (near_d == piece_type::empty) liberty++;
-			else if (near_d == who) check.emplace_back(x, y - 1);
+	/**
+	 * get the legal moves of a specific side as a bitboard, and the number of them
+	 * note that the moves of the side not to move are the moves it could play if it were its turn
+	 */
+	bitboard legal_moves(unsigned who) const { return moves[who - 1]; }
+	int legal_count(unsigned who) const { return popcount(moves[who - 1]); }
 
-			cell near_u = y < p_max.y ? test[x][y + 1] : -1u; // up
-			if (near_u == piece_type::empty) liberty++;
-			else if (near_u == who) check.emplace_back(x, y + 1);
-		}
-		return liberty;
+	/**
+	 * calculate the liberty of the block of piece at [x][y], i.e., the number of distinct empty points adjacent
+	 * to the block, where an empty point next to several stones of the block counts once
+	 * (the original flood fill counted it once per adjacent stone, which only agrees on whether it is zero)
+	 * return >= 0 if [x][y] is placed by who; otherwise return -1
+	 */
+	int check_liberty(int x, int y, unsigned who) const {
+		if (at(x * size_y + y) != who) return -1;
+		return popcount(liberties(blocks[group[x * size_y + y]]));
 	}
 
 	void transpose() {
+		grid stone = *this;
 		for (int x = 0; x < size_x; x++) {
 			for (int y = x + 1; y < size_y; y++) {
 				std::swap(stone[x][y], stone[y][x]);
 			}
 		}
+		assign(stone);
 	}
 
 	void reflect_horizontal() {
+		grid stone = *this;
 		for (int y = 0; y < size_y; y++) {
 			for (int x = 0; x < size_x / 2; x++) {
 				std::swap(stone[x][y], stone[size_x - 1 - x][y]);
 			}
 		}
+		assign(stone);
 	}
 
 	void reflect_vertical() {
+		grid stone = *this;
 		for (int x = 0; x < size_x; x++) {
 			for (int y = 0; y < size_y / 2; y++) {
 				std::swap(stone[x][y], stone[x][size_y - 1 - y]);
 			}
 		}
+		assign(stone);
 	}
 
 	/**
@@ -275,16 +419,296 @@ public:
 		return in;
 	}
 
+public:
+	static bitboard bit(int i) { return bitboard(1) << i; }
+	static int popcount(bitboard b) { return __builtin_popcountll(uint64_t(b)) + __builtin_popcountll(uint64_t(b >> 64)); }
+	static int lowest(bitboard b) { return uint64_t(b) ? __builtin_ctzll(uint64_t(b)) : 64 + __builtin_ctzll(uint64_t(b >> 64)); }
+
+	/**
+	 * get the index of the n-th (0-based) set bit of b
+	 */
+	static int nth(bitboard b, int n) {
+		uint64_t word = uint64_t(b);
+		int skip = __builtin_popcountll(word), base = 0;
+		if (n >= skip) word = uint64_t(b >> 64), n -= skip, base = 64;
+#if defined(__BMI2__)
+		return base + __builtin_ctzll(_pdep_u64(uint64_t(1) << n, word));
+#else
+		while (n--) word &= word - 1;
+		return base + __builtin_ctzll(word);
+#endif
+	}
+
+	/**
+	 * the masks of the hollow center, and of the points that can be placed
+	 */
+	static constexpr bitboard hollows() {
+		return lanes((size_x - hollow_x) / 2, hollow_x, ((bitboard(1) << hollow_y) - 1) << ((size_y - hollow_y) / 2));
+	}
+	static constexpr bitboard playable() {
+		return ((bitboard(1) << (size_x * size_y)) - 1) & ~hollows();
+	}
+
+	/**
+	 * get the playable points that are adjacent (left, right, down, up) to any point of b
+	 */
+	static bitboard neighbors(bitboard b) {
+		const bitboard bottom = lanes(0, size_x, 1), top = bottom << (size_y - 1);
+		return ((b >> size_y) | (b << size_y) | ((b & ~bottom) >> 1) | ((b & ~top) << 1)) & playable();
+	}
+
+	/**
+	 * get the playable points that are adjacent to point (i), by table lookup
+	 */
+	static bitboard adjacent(int i) {
+		static const std::array<bitboard, size_x * size_y> table = ([]() {
+			std::array<bitboard, size_x * size_y> table;
+			for (int i = 0; i < size_x * size_y; i++) table[i] = neighbors(bit(i));
+			return table;
+		})();
+		return table[i];
+	}
+
+	/**
+	 * get point (i) moved by transform (s) of the 8 symmetries of the board, which swaps x and y if bit 2 of s
+	 * is set, and then reflects x if bit 0 is set and reflects y if bit 1 is set, e.g., (s) == 6 rotates it as rotate_right()
+	 */
+	static int transform(int s, int i) {
+		static const std::array<std::array<uint8_t, size_x * size_y>, 8> table = ([]() {
+			std::array<std::array<uint8_t, size_x * size_y>, 8> table;
+			for (int s = 0; s < 8; s++) {
+				for (int i = 0; i < size_x * size_y; i++) {
+					int x = i / size_y, y = i % size_y;
+					if (s & 4) std::swap(x, y);
+					if (s & 1) x = size_x - 1 - x;
+					if (s & 2) y = size_y - 1 - y;
+					table[s][i] = x * size_y + y;
+				}
+			}
+			return table;
+		})();
+		return table[s][i];
+	}
+
+	/**
+	 * get the neighbors of point (i) in the slots of its 3x3 pattern, or -1 for the slots beyond the edge
+	 */
+	static const std::array<int8_t, 8>& around(int i) {
+		static const std::array<std::array<int8_t, 8>, size_x * size_y> table = ([]() {
+			std::array<std::array<int8_t, 8>, size_x * size_y> table;
+			for (int i = 0; i < size_x * size_y; i++) {
+				int x = i / size_y, y = i % size_y, k = 0;
+				for (int dx = -1; dx <= 1; dx++) {
+					for (int dy = -1; dy <= 1; dy++) {
+						if (dx == 0 && dy == 0) continue;
+						bool inside = x + dx >= 0 && x + dx < size_x && y + dy >= 0 && y + dy < size_y;
+						table[i][k++] = inside ? (x + dx) * size_y + (y + dy) : -1;
+					}
+				}
+			}
+			return table;
+		})();
+		return table[i];
+	}
+
+	/**
+	 * get the 3x3 patterns of all points of the empty board
+	 */
+	static const std::array<uint16_t, size_x * size_y>& blank() {
+		static const std::array<uint16_t, size_x * size_y> table = ([]() {
+			std::array<uint16_t, size_x * size_y> table;
+			for (int i = 0; i < size_x * size_y; i++) {
+				table[i] = 0;
+				for (int k = 0; k < 8; k++) {
+					int j = around(i)[k];
+					if (j == -1 || (hollows() & bit(j))) table[i] |= piece_type::hollow << (2 * k);
+				}
+			}
+			return table;
+		})();
+		return table;
+	}
+
+	/**
+	 * get the zobrist keys of a stone of who at point (i) for each transform (s), i.e., the key of the point
+	 * it is moved to, so that the board keeps the hashes of its 8 symmetric positions at once
+	 */
+	static const std::array<uint64_t, 8>& zobrist(unsigned who, int i) {
+		static const std::array<std::array<std::array<uint64_t, 8>, size_x * size_y>, 3> table = ([]() {
+			std::array<std::array<uint64_t, size_x * size_y>, 3> keys;
+			uint64_t seed = 0;
+			for (auto& row : keys) {
+				for (uint64_t& z : row) { // splitmix64
+					z = (seed += 0x9e3779b97f4a7c15ull);
+					z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+					z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+					z ^= z >> 31;
+				}
+			}
+			std::array<std::array<std::array<uint64_t, 8>, size_x * size_y>, 3> table;
+			for (int c = 0; c < 3; c++) {
+				for (int i = 0; i < size_x * size_y; i++) {
+					for (int s = 0; s < 8; s++) table[c][i][s] = keys[c][transform(s, i)];
+				}
+			}
+			return table;
+		})();
+		return table[who][i];
+	}
+	/**
+	 * get the zobrist key of the side to move, which reuses the key of an empty point
+	 */
+	static uint64_t turn(unsigned who) { return who == piece_type::white ? zobrist(piece_type::empty, 0)[0] : 0; }
+
+	/**
+	 * get the block which is connected to seed within the given mask
+	 */
+	static bitboard flood(bitboard seed, bitboard mask) {
+		for (bitboard block = seed & mask, next; ; block = next) {
+			next = (block | neighbors(block)) & mask;
+			if (next == block) return block;
+		}
+	}
+
 protected:
-	static const grid& initial() { static grid stone; return stone; }
-	static __attribute__((constructor)) void init_initial_scheme() {
-		grid& stone = const_cast<grid&>(initial());
-		point hollow((size_x - hollow_x) / 2, (size_y - hollow_y) / 2);
-		for (int x = hollow.x; x < hollow.x + hollow_x; x++)
-			for (int y = hollow.y; y < hollow.y + hollow_y; y++)
-				stone[x][y] = piece_type::hollow;
+	static constexpr bitboard lanes(unsigned x, unsigned n, bitboard column) {
+		return n ? (column << (x * size_y)) | lanes(x + 1, n - 1, column) : 0;
+	}
+
+	cell at(int i) const {
+		bitboard p = bit(i);
+		if (stone[0] & p) return piece_type::black;
+		if (stone[1] & p) return piece_type::white;
+		if (hollows() & p) return piece_type::hollow;
+		return piece_type::empty;
 	}
+	void set(int i, cell c) {
+		put(i, c);
+		rebuild();
+	}
+	void assign(const grid& g) {
+		for (int i = 0; i < size_x * size_y; i++) put(i, g[i / size_y][i % size_y]);
+		rebuild();
+	}
+	void put(int i, cell c) {
+		bitboard p = bit(i);
+		stone[0] &= ~p;
+		stone[1] &= ~p;
+		if ((c == piece_type::black || c == piece_type::white) && (playable() & p)) stone[c - 1] |= p;
+	}
+
+	/**
+	 * check whether an empty point is legal for who, regardless of the turn
+	 * return nogo_move_result::legal, illegal_suicide, or illegal_take
+	 */
+	reward legality(int i, unsigned who) const {
+		bitboard p = bit(i), near = adjacent(i);
+		unsigned opp = 3u - who;
+		if ((near & empties()) == 0) { // survive only if a connected block has another liberty
+			bitboard libs = 0;
+			for (bitboard own = near & stone[who - 1]; own; own &= own - 1)
+				libs |= liberties(blocks[group[lowest(own)]]);
+			if ((libs & ~p) == 0) return nogo_move_result::illegal_suicide;
+		}
+		for (bitboard take = near & stone[opp - 1]; take; take &= take - 1) {
+			if (liberties(blocks[group[lowest(take)]]) == p) return nogo_move_result::illegal_take;
+		}
+		return nogo_move_result::legal;
+	}
+
+	/**
+	 * recalculate the legal moves of both sides from the blocks in atari
+	 * a point is illegal if it is the last liberty of an opponent block (take), or if all its neighbors
+	 * are occupied and none of them belongs to an own block with another liberty (suicide)
+	 */
+	void update_legal() {
+		bitboard free = empties(), closed = free & ~neighbors(free);
+		for (int c = 0; c < 2; c++) {
+			bitboard safe = stone[c] & ~atari[c];
+			moves[c] = free & ~(closed & ~neighbors(safe)) & ~neighbors(atari[1 - c]);
+		}
+	}
+
+	/**
+	 * get the liberties of a block, i.e., its empty neighbors
+	 */
+	bitboard liberties(bitboard blk) const { return neighbors(blk) & empties(); }
+
+	static bool single(bitboard b) { return (b & (b - 1)) == 0; }
+
+	/**
+	 * add the new stone at point (i) to the blocks of who, merging the blocks around it into the largest of them,
+	 * and return the index of its block
+	 * the indices of the merged blocks are released by moving the last blocks into them, so the indices stay compact
+	 */
+	int join(int i, unsigned who) {
+		int merged[4], n = 0;
+		for (bitboard near = adjacent(i) & stone[who - 1]; near; near &= ~blocks[merged[n++]])
+			merged[n] = group[lowest(near)];
+		if (n == 0) {
+			group[i] = count;
+			blocks[count] = bit(i);
+			return count++;
+		}
+		std::swap(merged[0], *std::max_element(merged, merged + n, [this](int a, int b) {
+			return popcount(blocks[a]) < popcount(blocks[b]);
+		}));
+		int g = merged[0];
+		group[i] = g;
+		blocks[g] |= bit(i);
+		for (int k = 2; k < n; k++) { // the others from the highest index
+			for (int j = k; j > 1 && merged[j - 1] < merged[j]; j--) std::swap(merged[j - 1], merged[j]);
+		}
+		for (int k = 1; k < n; k++) {
+			int h = merged[k], last = --count;
+			for (bitboard s = blocks[h]; s; s &= s - 1) group[lowest(s)] = g;
+			blocks[g] |= blocks[h];
+			if (h == last) continue;
+			blocks[h] = blocks[last];
+			for (bitboard s = blocks[h]; s; s &= s - 1) group[lowest(s)] = h;
+			if (g == last) g = h;
+		}
+		return g;
+	}
+
+	/**
+	 * rebuild the blocks and their liberties from the stones
+	 */
+	void rebuild() {
+		atari = {};
+		key = {};
+		count = 0;
+		for (unsigned who = piece_type::black; who <= piece_type::white; who++) {
+			for (bitboard b = stone[who - 1]; b; b &= b - 1) {
+				const std::array<uint64_t, 8>& z = zobrist(who, lowest(b));
+				for (int s = 0; s < 8; s++) key[s] ^= z[s];
+			}
+		}
+		for (unsigned who = piece_type::black; who <= piece_type::white; who++) {
+			for (bitboard rest = stone[who - 1]; rest; ) {
+				bitboard blk = flood(rest & -rest, stone[who - 1]);
+				for (bitboard s = blk; s; s &= s - 1) group[lowest(s)] = count;
+				blocks[count++] = blk;
+				if (single(liberties(blk))) atari[who - 1] |= blk;
+				rest &= ~blk;
+			}
+		}
+		update_legal();
+	}
+
 private:
-	grid stone;
+	std::array<bitboard, 2> stone;
+	std::array<bitboard, 2> atari;
+	std::array<bitboard, 2> moves;
+	std::array<uint64_t, 8> key; // the hashes of the stones moved by each transform
 	data attr;
+
+	/**
+	 * the blocks are numbered compactly, where blocks[g] are the stones of block (g) < count, and group[i] is the
+	 * number of the block of stone (i); a block needs no stored liberties since they are its empty neighbors
+	 * a board has fewer blocks than playable points, and a copy only takes the blocks in use
+	 */
+	std::array<uint8_t, size_x * size_y> group;
+	uint8_t count;
+	std::array<bitboard, size_x * size_y - hollow_x * hollow_y> blocks;
 };
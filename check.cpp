@@ -0,0 +1,45 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * check.cpp: Regression checks of the players
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <string>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+
+/**
+ * a player takes its first moves randomly and is then given a search budget, so that it solves the endgame
+ * after a random move, where every move it takes must be legal
+ * return the number of games with an illegal move
+ */
+int check_random_then_solve(int games) {
+	int failed = 0;
+	for (int g = 0; g < games; g++) {
+		player black("role=black solve=12 seed=" + std::to_string(g));
+		player white("role=white seed=" + std::to_string(g + games));
+		board state;
+		for (unsigned who = board::black; state.legal_moves(who); who = 3u - who) {
+			player& mover = who == board::black ? black : white;
+			action::place move = mover.take_action(state);
+			if (move.apply(state) != board::legal) {
+				std::cerr << "game " << g << ": illegal move " << move.position() << " of " << mover.role() << std::endl;
+				failed++;
+				break;
+			}
+			if (who == board::black) black.notify("N=1");
+		}
+	}
+	return failed;
+}
+
+int main(int argc, const char* argv[]) {
+	int failed = check_random_then_solve(200);
+	std::cout << (failed ? "failed" : "passed") << ": random then solve (" << failed << " illegal)" << std::endl;
+	return failed ? 1 : 0;
+}
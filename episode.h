@@ -54,6 +54,33 @@ public:
 		return take_turns(white, black);
 	}
 
+	/**
+	 * play the game between black and white until a move is illegal or a player claims a win, where both players
+	 * are notified of its opening and closing, and observe(who, before, move) is called after each legal move
+	 * the episode itself should be opened and closed by the caller
+	 * return the winner
+	 */
+	template<typename observer>
+	agent& play(agent& black, agent& white, observer observe) {
+		black.open_episode("~:" + white.name());
+		white.open_episode(black.name() + ":~");
+		while (true) {
+			agent& who = take_turns(black, white);
+			action move = who.take_action(state());
+			board before = state();
+			if (apply_action(move) != true) break;
+			observe(who, before, move);
+			if (who.check_for_win(state())) break;
+		}
+		agent& win = last_turns(black, white);
+		black.close_episode(win.name());
+		white.close_episode(win.name());
+		return win;
+	}
+	agent& play(agent& black, agent& white) {
+		return play(black, white, [](agent&, const board&, const action&) {});
+	}
+
 public:
 	size_t step(unsigned who = -1u) const {
 		int size = ep_moves.size();
@@ -0,0 +1,270 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * match.cpp: Match runner between two GTP engines with the sequential probability ratio test
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "board.h"
+#include "action.h"
+
+/**
+ * GTP engine running as a child process, whose standard input and output are connected by pipes
+ */
+class engine {
+public:
+	engine(const std::string& command) : command(command), pid(-1), in(nullptr), out(nullptr) {
+		// the pipes are closed on exec so that an engine never holds the pipes of the others, and the child
+		// only makes async-signal-safe calls, since other threads may hold the allocator's lock at fork
+		std::string exec = "exec " + command;
+		int down[2], up[2];
+		if (pipe2(down, O_CLOEXEC) != 0 || pipe2(up, O_CLOEXEC) != 0) throw std::runtime_error("cannot create pipes for: " + command);
+		pid = fork();
+		if (pid == -1) throw std::runtime_error("cannot fork for: " + command);
+		if (pid == 0) {
+			dup2(down[0], STDIN_FILENO);
+			dup2(up[1], STDOUT_FILENO);
+			execl("/bin/sh", "sh", "-c", exec.c_str(), (char*) nullptr);
+			_exit(127);
+		}
+		close(down[0]), close(up[1]);
+		in = fdopen(down[1], "w");
+		out = fdopen(up[0], "r");
+	}
+	engine(const engine&) = delete;
+	engine& operator =(const engine&) = delete;
+	~engine() {
+		if (in) { fputs("quit\n", in); fclose(in); }
+		if (out) fclose(out);
+		if (pid > 0) waitpid(pid, nullptr, 0);
+	}
+
+	/**
+	 * send a command and return the reply without the leading "= ", or throw if the engine fails or exits
+	 * the lines before the reply, such as a banner, are skipped
+	 */
+	std::string send(const std::string& cmd) {
+		if (fprintf(in, "%s\n", cmd.c_str()) < 0 || fflush(in) != 0) throw std::runtime_error(command + ": cannot send " + cmd);
+		std::string reply, line;
+		bool started = false;
+		for (char buf[256]; fgets(buf, sizeof(buf), out); ) {
+			line += buf;
+			if (line.back() != '\n') continue;
+			while (line.size() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+			if (!started && (line.find("=") == 0 || line.find("?") == 0)) {
+				if (line[0] == '?') throw std::runtime_error(command + ": " + cmd + " failed with " + line);
+				started = true;
+				reply = line.substr(line.find_first_not_of("= ") == std::string::npos ? line.size() : line.find_first_not_of("= "));
+			} else if (started && line.empty()) {
+				return reply;
+			} else if (started) {
+				reply += "\n" + line;
+			}
+			line.clear();
+		}
+		throw std::runtime_error(command + ": exited during " + cmd);
+	}
+
+private:
+	std::string command;
+	pid_t pid;
+	FILE* in;
+	FILE* out;
+};
+
+/**
+ * sequential probability ratio test of whether the first engine is elo1 rather than elo0 stronger,
+ * where a game is a Bernoulli trial with the win probability of the Elo difference
+ * the test accepts H1 once the log-likelihood ratio reaches log((1 - beta) / alpha), and accepts H0
+ * once it drops to log(beta / (1 - alpha))
+ */
+class sprt {
+public:
+	sprt(double elo0, double elo1, double alpha, double beta) : win(0), loss(0),
+		p0(expected(elo0)), p1(expected(elo1)), lower(std::log(beta / (1 - alpha))), upper(std::log((1 - beta) / alpha)) {}
+
+	void add(bool won) { (won ? win : loss)++; }
+	double llr() const { return win * std::log(p1 / p0) + loss * std::log((1 - p1) / (1 - p0)); }
+	int status() const { return llr() >= upper ? 1 : llr() <= lower ? -1 : 0; } // 1 for H1, -1 for H0, 0 to continue
+
+	/**
+	 * the Elo difference of the score so far, and the half width of its 95% confidence interval
+	 */
+	double elo() const { return difference(score()); }
+	double margin() const {
+		size_t n = win + loss;
+		if (n == 0) return 0;
+		double s = score(), d = 1.96 * std::sqrt(s * (1 - s) / n);
+		return (difference(s + d) - difference(s - d)) / 2;
+	}
+
+	friend std::ostream& operator <<(std::ostream& out, const sprt& t) {
+		return out << "W-L " << t.win << "-" << t.loss << ", elo " << std::showpos << std::fixed << std::setprecision(1)
+		           << t.elo() << std::noshowpos << " +- " << t.margin() << ", LLR " << std::setprecision(2) << t.llr()
+		           << " [" << t.lower << ", " << t.upper << "]";
+	}
+
+	size_t win, loss;
+
+private:
+	double score() const { return (win + 0.5) / (win + loss + 1); } // smoothed to keep the Elo finite
+	static double expected(double elo) { return 1 / (1 + std::pow(10, -elo / 400)); }
+	static double difference(double score) {
+		score = std::min(std::max(score, 1e-6), 1 - 1e-6);
+		return -400 * std::log10(1 / score - 1);
+	}
+
+	double p0, p1, lower, upper;
+};
+
+/**
+ * match between two engines, where the games are played by several workers, each with its own pair of engine processes
+ * game g is played with the first engine as black if g is even, so that the colors alternate
+ * every move is checked in-process as the judge does, i.e., an illegal move loses, and so does resigning or passing,
+ * which is also reported if the side still had a legal move
+ */
+class match {
+public:
+	match(const std::string& first, const std::string& second, size_t games, const sprt& test)
+		: first(first), second(second), games(games), next(0), test(test), illegal(0), early(0), failed(false) {}
+
+	/**
+	 * run the match with the workers, and return the exit code, i.e., 0 if H1 is accepted, 1 if H0 is accepted,
+	 * 2 if an engine failed, or 3 if the games ran out before the test was decided
+	 */
+	int run(size_t concurrency) {
+		std::vector<std::thread> workers;
+		for (size_t k = 0; k < concurrency; k++) workers.push_back(std::thread(&match::work, this));
+		for (std::thread& t : workers) t.join();
+		std::cout << "result: " << test << ", " << (test.status() > 0 ? "H1 accepted" : test.status() < 0 ? "H0 accepted" : "inconclusive");
+		std::cout << " (illegal " << illegal << ", early resign " << early << ")" << std::endl;
+		return failed ? 2 : test.status() > 0 ? 0 : test.status() < 0 ? 1 : 3;
+	}
+
+protected:
+	void work() {
+		try {
+			engine a(first), b(second);
+			for (size_t g; (g = take()) < games; ) {
+				engine& black = g % 2 == 0 ? a : b;
+				engine& white = g % 2 == 0 ? b : a;
+				std::string note;
+				unsigned winner = play(black, white, note);
+				bool won = winner == (g % 2 == 0 ? board::black : board::white);
+				std::lock_guard<std::mutex> lock(mutex);
+				test.add(won);
+				std::cout << "game " << g << ": " << (won ? "first" : "second") << " wins as " << (winner == board::black ? "black" : "white");
+				std::cout << note << ", " << test << std::endl;
+			}
+		} catch (const std::exception& e) {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::cerr << e.what() << std::endl;
+			failed = true;
+		}
+	}
+
+	/**
+	 * play a game and return the winner
+	 */
+	unsigned play(engine& black, engine& white, std::string& note) {
+		black.send("clear_board");
+		white.send("clear_board");
+		board state;
+		for (unsigned who = board::black; ; who = 3u - who) {
+			engine& mover = who == board::black ? black : white;
+			engine& other = who == board::black ? white : black;
+			std::string color = who == board::black ? "b" : "w";
+			std::string reply = mover.send("genmove " + color);
+			std::string lower = reply, upper = reply;
+			for (char& c : lower) c = std::tolower(c);
+			for (char& c : upper) c = std::toupper(c);
+			if (lower == "resign" || lower == "pass") {
+				if (state.legal_moves(who)) {
+					std::lock_guard<std::mutex> lock(mutex);
+					early++;
+					note = " (early " + lower + ")";
+				}
+				return 3u - who;
+			}
+			board::point p(upper);
+			if (p.i == -1 || state.place(p, who) != board::legal) {
+				std::lock_guard<std::mutex> lock(mutex);
+				illegal++;
+				note = " (illegal " + reply + ")";
+				return 3u - who;
+			}
+			other.send("play " + color + " " + std::string(p));
+		}
+	}
+
+	/**
+	 * take the index of the next game, or games if the match is over
+	 */
+	size_t take() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (failed || test.status() != 0) return games;
+		return next < games ? next++ : games;
+	}
+
+private:
+	std::string first, second;
+	size_t games, next;
+	sprt test;
+	size_t illegal, early;
+	bool failed;
+	std::mutex mutex;
+};
+
+int main(int argc, const char* argv[]) {
+	std::string first, second;
+	size_t games = 1000, concurrency = 1;
+	double elo0 = 0, elo1 = 10, alpha = 0.05, beta = 0.05;
+	for (int i = 1; i < argc; i++) {
+		std::string para(argv[i]);
+		if (para.find("--first=") == 0) {
+			first = para.substr(para.find("=") + 1);
+		} else if (para.find("--second=") == 0) {
+			second = para.substr(para.find("=") + 1);
+		} else if (para.find("--games=") == 0) {
+			games = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--concurrency=") == 0) {
+			concurrency = std::max<size_t>(std::stoull(para.substr(para.find("=") + 1)), 1);
+		} else if (para.find("--elo0=") == 0) {
+			elo0 = std::stod(para.substr(para.find("=") + 1));
+		} else if (para.find("--elo1=") == 0) {
+			elo1 = std::stod(para.substr(para.find("=") + 1));
+		} else if (para.find("--alpha=") == 0) {
+			alpha = std::stod(para.substr(para.find("=") + 1));
+		} else if (para.find("--beta=") == 0) {
+			beta = std::stod(para.substr(para.find("=") + 1));
+		}
+	}
+	if (first.empty() || second.empty()) {
+		std::cerr << "usage: " << argv[0] << " --first=CMD --second=CMD [--games=N] [--concurrency=K]"
+		          << " [--elo0=E0] [--elo1=E1] [--alpha=A] [--beta=B]" << std::endl;
+		return 2;
+	}
+	std::signal(SIGPIPE, SIG_IGN); // an engine that exits is reported by its failed command instead
+
+	std::cout << "match: " << first << " vs " << second << ", SPRT elo0=" << elo0 << " elo1=" << elo1
+	          << " alpha=" << alpha << " beta=" << beta << std::endl;
+	return match(first, second, games, sprt(elo0, elo1, alpha, beta)).run(concurrency);
+}
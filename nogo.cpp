@@ -16,6 +16,8 @@
 #include "agent.h"
 #include "episode.h"
 #include "statistic.h"
+#include "selfplay.h"
+#include "tournament.h"
 
 int main(int argc, const char* argv[]) {
 	std::cout << "HollowNoGo-Demo: ";
@@ -25,6 +27,9 @@ int main(int argc, const char* argv[]) {
 	size_t total = 1000, block = 0, limit = 0;
 	std::string black_args, white_args;
 	std::string load, save;
+	std::string record; // for self-play
+	size_t parallel = 1, shard = 1000000;
+	unsigned seed = std::random_device()() & 0x3fffffff;
 	std::string name = "TCG-HollowNoGo-Demo", version = "2021"; // for GTP shell
 	bool summary = false, shell = false;
 	for (int i = 1; i < argc; i++) {
@@ -47,6 +52,14 @@ int main(int argc, const char* argv[]) {
 			name = para.substr(para.find("=") + 1);
 		} else if (para.find("--version=") == 0) {
 			version = para.substr(para.find("=") + 1);
+		} else if (para.find("--selfplay=") == 0) {
+			record = para.substr(para.find("=") + 1);
+		} else if (para.find("--parallel=") == 0) {
+			parallel = std::max<size_t>(std::stoull(para.substr(para.find("=") + 1)), 1);
+		} else if (para.find("--shard=") == 0) {
+			shard = std::stoull(para.substr(para.find("=") + 1));
+		} else if (para.find("--seed=") == 0) {
+			seed = std::stoul(para.substr(para.find("=") + 1));
 		} else if (para.find("--summary") == 0) {
 			summary = true;
 		} else if (para.find("--shell") == 0) {
@@ -54,6 +67,12 @@ int main(int argc, const char* argv[]) {
 		}
 	}
 
+	if (record.size()) { // launch self-play games and record their positions
+		std::cout << "selfplay: seed=" << seed << std::endl;
+		selfplay(black_args, white_args, record, shard).run(total, parallel, seed);
+		return 0;
+	}
+
 	statistic stat(total, block, limit);
 
 	if (load.size()) {
@@ -66,29 +85,22 @@ int main(int argc, const char* argv[]) {
 	player black("name=black " + black_args + " role=black");
 	player white("name=white " + white_args + " role=white");
 
-	if (!shell) { // launch standard local games
+	if (!shell && parallel > 1) { // launch local games in parallel
+		std::cout << "parallel: seed=" << seed << std::endl;
+		tournament(black_args, white_args).run(stat, parallel, seed);
+	} else if (!shell) { // launch standard local games
 		while (!stat.is_finished()) {
-			black.open_episode("~:" + white.name());
-			white.open_episode(black.name() + ":~");
-
 			stat.open_episode(black.name() + ":" + white.name());
-			episode& game = stat.back();
-			while (true) {
-				agent& who = game.take_turns(black, white);
-				action move = who.take_action(game.state());
-				if (game.apply_action(move) != true) break;
-				if (who.check_for_win(game.state())) break;
-			}
-			agent& win = game.last_turns(black, white);
+			agent& win = stat.back().play(black, white);
 			stat.close_episode(win.name());
-
-			black.close_episode(win.name());
-			white.close_episode(win.name());
 		}
 	} else { // launch GTP shell
 		for (std::string command; std::getline(std::cin, command); ) {
 			if (command.back() == '\r') command.pop_back();
 			if (command.empty()) continue;
+			black.stop(); // stop pondering once the opponent has replied
+			white.stop();
+			agent* thinker = nullptr;
 
 			std::vector<std::string> args;
 			std::istringstream iss(command);
@@ -139,6 +151,7 @@ int main(int argc, const char* argv[]) {
 					action::place move = who.take_action(game.state());
 					if (game.apply_action(move) == true) {
 						reply = move.position();
+						thinker = &who;
 					} else { // I have no legal move to play
 						reply = "resign";
 					}
@@ -180,6 +193,7 @@ int main(int argc, const char* argv[]) {
 			}
 
 			std::cout << "= " << reply << std::endl << std::endl;
+			if (thinker) thinker->ponder(stat.back().state()); // think on the opponent's time
 		}
 	}
 
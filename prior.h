@@ -0,0 +1,55 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * prior.h: Define the prior policies that order the moves to be expanded by MCTS
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include "board.h"
+
+/**
+ * base prior policy, which scores the legal moves of the side to move, where a higher score is expanded earlier
+ */
+class prior {
+public:
+	virtual ~prior() {}
+
+	/**
+	 * score each move in moves by writing score[i] for move i, the other entries are left unchanged
+	 */
+	virtual void evaluate(const board& state, board::bitboard moves, float score[]) const = 0;
+
+	/**
+	 * create the prior policy by name, or return nullptr for none
+	 */
+	static std::shared_ptr<prior> make(const std::string& name);
+};
+
+/**
+ * mobility prior, which scores a move by how few legal moves it leaves to the opponent, i.e., it favors
+ * the moves that also take away the opponent's moves around them
+ */
+class mobility : public prior {
+public:
+	virtual void evaluate(const board& state, board::bitboard moves, float score[]) const {
+		unsigned opponent = 3u - state.info().who_take_turns;
+		for (; moves; moves &= moves - 1) {
+			int i = board::lowest(moves);
+			board after = state;
+			after.place(board::point(i));
+			score[i] = -after.legal_count(opponent);
+		}
+	}
+};
+
+inline std::shared_ptr<prior> prior::make(const std::string& name) {
+	if (name == "none") return nullptr;
+	if (name == "mobility") return std::make_shared<mobility>();
+	throw std::invalid_argument("invalid prior: " + name);
+}
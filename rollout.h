@@ -0,0 +1,156 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * rollout.h: Define the playout policies for Monte-Carlo simulations
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <random>
+#include <array>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "board.h"
+
+/**
+ * uniformly random playout
+ * the board is copied onto the stack and the moves are sampled from its legal mask,
+ * so a playout performs no heap allocation and never retries an illegal move
+ */
+class rollout {
+public:
+	/**
+	 * play random legal moves until the side to move has no legal move
+	 * return the winner, i.e., the side that made the last move, and also the final stones if requested
+	 */
+	template<typename engine_t>
+	static board::piece_type simulate(board state, engine_t& engine, std::array<board::bitboard, 2>* stones = nullptr) {
+		for (unsigned who = state.info().who_take_turns; ; who = 3u - who) {
+			board::bitboard moves = state.legal_moves(who);
+			if (moves == 0) {
+				if (stones) *stones = {{ state.stones(board::black), state.stones(board::white) }};
+				return static_cast<board::piece_type>(3u - who);
+			}
+			std::uniform_int_distribution<int> pick(0, board::popcount(moves) - 1);
+			state.place(board::point(board::nth(moves, pick(engine))), who);
+		}
+	}
+};
+
+/**
+ * pattern playout, which samples the legal moves by the weights of their 3x3 patterns (see board::pattern)
+ * a move is drawn uniformly from the legal mask and accepted with the probability of its weight, so that
+ * a draw takes O(1), and the move drawn after a few rejections is taken anyway to bound the cost
+ * the weights are kept for black to move, and a pattern of white to move is looked up with the colors swapped
+ *
+ * by default, a move is only rejected if it fills an eye of the mover, i.e., a point whose 4 sides are
+ * all own stones or edges, since the opponent cannot play there and it is better kept for later
+ */
+class patterns {
+public:
+	enum { tries = 4 }; // the draws before a move is taken regardless of its weight
+
+	patterns() {
+		for (uint32_t code = 0; code < weight.size(); code++) {
+			bool eye = true;
+			for (int k : { 1, 3, 4, 6 }) eye &= ((code >> (2 * k)) & 3) == board::black || ((code >> (2 * k)) & 3) == board::hollow;
+			weight[code] = eye ? 26 : 256;
+		}
+	}
+
+	/**
+	 * load the weights from a file, in which each line is a pattern and its weight in [0, 1], e.g., "XX.X.O#O. 0.25"
+	 * a pattern lists its 9 points row by row from the top left, as shown by the board, where X is the mover, O is
+	 * the opponent, # is the edge or the hollow, . is empty, and the center is ignored
+	 * a weight applies to all the 8 symmetric patterns, and the patterns not listed keep their default weights
+	 */
+	void load(const std::string& path) {
+		std::ifstream in(path);
+		if (!in.is_open()) throw std::runtime_error("cannot open weights: " + path);
+		std::string line;
+		while (std::getline(in, line)) {
+			std::stringstream ss(line);
+			std::string shape;
+			float w;
+			if (!(ss >> shape)) continue;
+			if (shape.size() != 9 || !(ss >> w) || w < 0 || w > 1)
+				throw std::runtime_error("invalid weight: " + line);
+			uint16_t code = 0;
+			for (int k = 0; k < 8; k++) {
+				int dx, dy;
+				offset(k, dx, dy);
+				char c = shape[(1 - dy) * 3 + (dx + 1)];
+				if (c != '.' && c != 'X' && c != 'O' && c != '#')
+					throw std::runtime_error("invalid weight: " + line);
+				unsigned type = c == 'X' ? board::black : c == 'O' ? board::white : c == '#' ? board::hollow : board::empty;
+				code |= type << (2 * k);
+			}
+			for (int s = 0; s < 8; s++) weight[transform(s, code)] = uint16_t(w * 256 + 0.5f);
+		}
+	}
+
+	/**
+	 * play legal moves sampled by the weights until the side to move has no legal move
+	 * return the winner, i.e., the side that made the last move, and also the final stones if requested
+	 * the engine is expected to produce 64 random bits, the lower half draws a move and the upper half accepts it
+	 */
+	template<typename engine_t>
+	board::piece_type simulate(board state, engine_t& engine, std::array<board::bitboard, 2>* stones = nullptr) const {
+		for (unsigned who = state.info().who_take_turns; ; who = 3u - who) {
+			board::bitboard moves = state.legal_moves(who);
+			if (moves == 0) {
+				if (stones) *stones = {{ state.stones(board::black), state.stones(board::white) }};
+				return static_cast<board::piece_type>(3u - who);
+			}
+			uint64_t n = board::popcount(moves);
+			int i;
+			for (int k = 0; ; k++) {
+				uint64_t r = engine();
+				i = board::nth(moves, ((r & 0xffffffffu) * n) >> 32);
+				uint16_t code = state.pattern(i);
+				if (who == board::white) code = swap(code);
+				if (k == tries - 1 || ((r >> 32) & 255) < weight[code]) break;
+			}
+			state.place(board::point(i), who);
+		}
+	}
+
+protected:
+	/**
+	 * get the offset (dx, dy) of slot k of a pattern
+	 */
+	static void offset(int k, int& dx, int& dy) {
+		int m = k < 4 ? k : k + 1;
+		dx = m / 3 - 1, dy = m % 3 - 1;
+	}
+
+	/**
+	 * move the neighbors of a pattern by transform (s) as board::transform, i.e., swap dx and dy if bit 2 of s is set,
+	 * and then negate dx if bit 0 is set and negate dy if bit 1 is set
+	 */
+	static uint16_t transform(int s, uint16_t code) {
+		uint16_t moved = 0;
+		for (int k = 0; k < 8; k++) {
+			int dx, dy;
+			offset(k, dx, dy);
+			if (s & 4) std::swap(dx, dy);
+			if (s & 1) dx = -dx;
+			if (s & 2) dy = -dy;
+			int m = 3 * (dx + 1) + (dy + 1);
+			moved |= ((code >> (2 * k)) & 3) << (2 * (m < 4 ? m : m - 1));
+		}
+		return moved;
+	}
+
+	/**
+	 * swap the black and the white neighbors of a pattern
+	 */
+	static uint16_t swap(uint16_t code) { return code ^ (((code ^ (code >> 1)) & 0x5555) * 3); }
+
+private:
+	std::array<uint16_t, 1 << 16> weight; // the acceptance threshold of 8 random bits, i.e., 256 times the weight
+};
@@ -1,8 +1,8 @@
 #!/bin/bash
 echo "GoGui-TwoGTP Launcher V20211112"
 # commands for player 1
-P1B='./nogo --shell --name="poleedrew" --black="T=1000000 thread=4 C=0.3"'
-P1W='./nogo --shell --name="poleedrew" --white="T=1000000 thread=4 C=0.3"'
+P1B='./nogo --shell --name="poleedrew" --black="time=36 thread=4 ponder=1 rave=300 C=0.3"'
+P1W='./nogo --shell --name="poleedrew" --white="time=36 thread=4 ponder=1 rave=300 C=0.3"'
 # commands for local player 2
 # P2B='./nogo-judge --shell --name="Judge-Weak-Black" --black="weak"'
 # P2W='./nogo-judge --shell --name="Judge-Weak-White" --white="weak"'
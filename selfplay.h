@@ -0,0 +1,171 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * selfplay.h: Define the self-play games and their binary records
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <stdexcept>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+
+/**
+ * writer of the binary records of self-play positions, which are written one game at a time into shard files
+ * named PREFIX-0000.bin, PREFIX-0001.bin, ..., and a new shard is started once the current one has enough positions
+ *
+ * each position is a record laid out as follows, where the integers are little-endian
+ *   16 bytes   the black stones as a bitboard, i.e., bit (i) is point (i)
+ *   16 bytes   the white stones as a bitboard
+ *   1 byte     the side to move, 1 for black and 2 for white
+ *   1 byte     the move played, i.e., point (i)
+ *   1 byte     the winner of the game, 1 for black and 2 for white
+ *   1 byte     the number (n) of the moves searched, which is 0 if the move was not searched by MCTS
+ *   5n bytes   each move searched, as 1 byte of its point and 4 bytes of its visit count at the root
+ */
+class recorder {
+public:
+	recorder(const std::string& prefix, size_t shard) : prefix(prefix), shard(shard), index(0), count(0), total(0) {}
+
+	/**
+	 * add a position of the ongoing game, with the move played and the visit counts of the search
+	 */
+	void add(const board& state, int move, const std::array<uint32_t, board::size_x * board::size_y>& visit) {
+		put(state.stones(board::black), 16);
+		put(state.stones(board::white), 16);
+		game.push_back(char(state.info().who_take_turns));
+		game.push_back(char(move));
+		winners.push_back(game.size());
+		game.push_back(char(board::empty));
+		size_t n = game.size();
+		game.push_back(char(0));
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			if (visit[i] == 0) continue;
+			game.push_back(char(i));
+			put(visit[i], 4);
+			game[n]++;
+		}
+	}
+
+	/**
+	 * complete the ongoing game with its winner and write its positions
+	 * return the name of the shard if it is full after this game, or an empty string
+	 */
+	std::string finish(unsigned winner) {
+		for (size_t i : winners) game[i] = char(winner);
+		if (!out.is_open()) {
+			out.open(name(), std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!out.is_open()) throw std::runtime_error("cannot open record: " + name());
+		}
+		out.write(game.data(), game.size());
+		out.flush();
+		count += winners.size();
+		total += winners.size();
+		game.clear();
+		winners.clear();
+		if (count < shard) return {};
+		std::string full = name();
+		out.close();
+		index++;
+		count = 0;
+		return full;
+	}
+
+	/**
+	 * get the number of positions written
+	 */
+	size_t positions() const { return total; }
+
+protected:
+	template<typename type> void put(type v, size_t bytes) {
+		for (size_t i = 0; i < bytes; i++, v >>= 8) game.push_back(char(v & 0xff));
+	}
+
+	std::string name() const {
+		std::stringstream ss;
+		ss << prefix << '-' << std::setw(4) << std::setfill('0') << index << ".bin";
+		return ss.str();
+	}
+
+private:
+	std::string prefix;
+	size_t shard;
+	size_t index, count, total;
+	std::ofstream out;
+	std::string game;
+	std::vector<size_t> winners; // the offsets of the winners of the positions of the ongoing game
+};
+
+/**
+ * self-play games between two players, played by several workers in parallel
+ * each worker has its own pair of players, seeded differently, and writes its own shards named PREFIX-WW-0000.bin,
+ * so that the workers share nothing but the count of games to be played
+ */
+class selfplay {
+public:
+	selfplay(const std::string& black_args, const std::string& white_args, const std::string& prefix, size_t shard)
+		: black_args(black_args), white_args(white_args), prefix(prefix), shard(shard) {}
+
+	/**
+	 * play the given number of games with the workers, where worker k seeds its players with seed + 2k and seed + 2k + 1
+	 */
+	void run(size_t total, size_t parallel, unsigned seed) {
+		auto start = std::chrono::steady_clock::now();
+		std::atomic<size_t> next(0);
+		std::vector<size_t> positions(parallel);
+		std::vector<std::thread> workers;
+		for (size_t k = 0; k < parallel; k++)
+			workers.push_back(std::thread(&selfplay::work, this, k, seed + 2 * k, std::ref(next), total, std::ref(positions[k])));
+		for (std::thread& t : workers) t.join();
+
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		size_t sum = 0;
+		for (size_t n : positions) sum += n;
+		std::cout << "selfplay: " << total << " games, " << sum << " positions in " << std::fixed << std::setprecision(1)
+		          << elapsed << " s (" << (sum / elapsed) << " positions/s)" << std::endl;
+	}
+
+protected:
+	void work(size_t id, unsigned seed, std::atomic<size_t>& next, size_t total, size_t& positions) {
+		std::stringstream ss;
+		ss << prefix << '-' << std::setw(2) << std::setfill('0') << id;
+		recorder record(ss.str(), shard);
+		player black("name=black " + black_args + " role=black seed=" + std::to_string(seed));
+		player white("name=white " + white_args + " role=white seed=" + std::to_string(seed + 1));
+		std::array<uint32_t, board::size_x * board::size_y> visit;
+		while (next++ < total) {
+			episode game;
+			agent& win = game.play(black, white, [&](agent& who, const board& state, const action& move) {
+				static_cast<player&>(who).visits(state, visit);
+				record.add(state, action::place(move).position().i, visit);
+			});
+			std::string full = record.finish(&win == &black ? board::black : board::white);
+			if (full.size()) {
+				std::lock_guard<std::mutex> lock(output);
+				std::cout << "selfplay: " << full << std::endl;
+			}
+		}
+		positions = record.positions();
+	}
+
+private:
+	std::string black_args, white_args;
+	std::string prefix;
+	size_t shard;
+	std::mutex output;
+};
@@ -0,0 +1,95 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * solver.h: Define the exact endgame solver
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include "board.h"
+
+/**
+ * alpha-beta search for the win or loss of the side to move, which is a null-window search since
+ * NoGo has only two outcomes, i.e., a position is won if any move leads to a lost position
+ *
+ * results are kept in a transposition table keyed by the canonical hash, so that they are shared by
+ * symmetric positions and remain valid for the later positions of the same game or the next games
+ * moves are ordered by trying first those legal for both sides, since taking such a point also removes
+ * a move of the opponent, while the moves only legal for the side to move can be kept for later
+ */
+class solver {
+public:
+	enum outcome { loss = -1, unknown = 0, win = 1 };
+
+	typedef std::chrono::steady_clock clock;
+
+	solver(size_t bits = 18) : table(size_t(1) << bits), nodes(0), budget(0), deadline() {}
+
+	/**
+	 * solve the state for the side to move by searching at most limit nodes before the given time
+	 * return win (with the winning move in best, if given) or loss, or unknown if the budget is exhausted
+	 * the clock is only read every 1024 nodes
+	 */
+	outcome solve(const board& state, size_t limit, int* best = nullptr, clock::time_point until = clock::time_point::max()) {
+		nodes = 0;
+		budget = limit;
+		deadline = until;
+		return search(state, best);
+	}
+
+	/**
+	 * get the number of nodes searched by the last solve
+	 */
+	size_t searched() const { return nodes; }
+
+protected:
+	struct entry {
+		uint64_t key;
+		int8_t result;
+	};
+
+	outcome search(const board& state, int* best = nullptr) {
+		if (++nodes > budget) return unknown;
+		if (nodes % 1024 == 0 && clock::now() >= deadline) {
+			budget = 0;
+			return unknown;
+		}
+		uint64_t key = state.canonical_hash();
+		entry& e = table[key & (table.size() - 1)];
+		if (e.key == key && best == nullptr) return outcome(e.result);
+
+		unsigned who = state.info().who_take_turns;
+		board::bitboard mine = state.legal_moves(who), theirs = state.legal_moves(3u - who);
+		if (best == nullptr) mine = state.distinct(mine); // symmetric moves lead to the same result
+		board::bitboard order[] = { mine & theirs, mine & ~theirs };
+		for (board::bitboard moves : order) {
+			for (; moves; moves &= moves - 1) {
+				board after = state;
+				after.place(board::point(board::lowest(moves)));
+				outcome result = search(after);
+				if (result == unknown) return unknown;
+				if (result == loss) {
+					if (best) *best = board::lowest(moves);
+					return store(e, key, win);
+				}
+			}
+		}
+		return store(e, key, loss);
+	}
+
+	outcome store(entry& e, uint64_t key, outcome result) {
+		e.key = key;
+		e.result = result;
+		return result;
+	}
+
+private:
+	std::vector<entry> table;
+	size_t nodes, budget;
+	clock::time_point deadline;
+};
@@ -90,6 +90,10 @@ public:
 		return count >= total;
 	}
 
+	size_t remaining() const {
+		return is_finished() ? 0 : total - count;
+	}
+
 	bool is_episode_ongoing() const {
 		return data.size() && data.back().ep_close.when == 0;
 	}
@@ -105,6 +109,15 @@ public:
 		if (count % block == 0) show();
 	}
 
+	/**
+	 * add an episode that was opened and closed elsewhere, e.g., by another thread
+	 */
+	void merge(episode&& ep) {
+		if (count++ >= limit) data.pop_front();
+		data.push_back(std::move(ep));
+		if (count % block == 0) show();
+	}
+
 	episode& at(size_t i) {
 		auto it = data.begin();
 		while (i--) it++;
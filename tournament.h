@@ -0,0 +1,95 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * tournament.h: Define the local games played in parallel
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "statistic.h"
+
+/**
+ * channel through which threads hand over items to one consumer in batches
+ * push() appends an item under a short lock, and pull() waits for any item and takes all of them at once
+ */
+template<typename type>
+class channel {
+public:
+	void push(type&& item) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			items.push_back(std::move(item));
+		}
+		ready.notify_one();
+	}
+
+	void pull(std::vector<type>& batch) {
+		batch.clear();
+		std::unique_lock<std::mutex> lock(mutex);
+		ready.wait(lock, [this]() { return items.size() != 0; });
+		std::swap(batch, items);
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable ready;
+	std::vector<type> items;
+};
+
+/**
+ * local games between two players, played by several workers in parallel
+ * each worker has its own pair of players, where worker k seeds them with seed + 2k and seed + 2k + 1, and
+ * sends its finished episodes through a channel, from which the calling thread merges them into the statistic
+ * in the order they finish, so that the statistic is only ever accessed by one thread
+ */
+class tournament {
+public:
+	tournament(const std::string& black_args, const std::string& white_args)
+		: black_args(black_args), white_args(white_args) {}
+
+	/**
+	 * play the remaining games of the statistic with the workers
+	 */
+	void run(statistic& stat, size_t parallel, unsigned seed) {
+		size_t games = stat.remaining();
+		std::atomic<size_t> next(0);
+		channel<episode> results;
+		std::vector<std::thread> workers;
+		for (size_t k = 0; k < parallel; k++)
+			workers.push_back(std::thread(&tournament::work, this, seed + 2 * k, std::ref(next), games, std::ref(results)));
+		std::vector<episode> batch;
+		for (size_t done = 0; done < games; done += batch.size()) {
+			results.pull(batch);
+			for (episode& game : batch) stat.merge(std::move(game));
+		}
+		for (std::thread& t : workers) t.join();
+	}
+
+protected:
+	void work(unsigned seed, std::atomic<size_t>& next, size_t games, channel<episode>& results) {
+		player black("name=black " + black_args + " role=black seed=" + std::to_string(seed));
+		player white("name=white " + white_args + " role=white seed=" + std::to_string(seed + 1));
+		while (next++ < games) {
+			episode game;
+			game.open_episode(black.name() + ":" + white.name());
+			agent& win = game.play(black, white);
+			game.close_episode(win.name());
+			results.push(std::move(game));
+		}
+	}
+
+private:
+	std::string black_args, white_args;
+};
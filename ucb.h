@@ -0,0 +1,151 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * ucb.h: Define the batched UCB kernel for the selection of MCTS
+ *
+ * Author: Theory of Computer Games (TCG 2021)
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <array>
+#include "board.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UCB_AVX2 1 // the AVX2 kernel is compiled for x86 regardless of -mavx2, and is chosen at runtime
+#endif
+
+#if !defined(UCB_TABLE_SIZE)
+#define UCB_TABLE_SIZE 4096 // visit counts below it are looked up in tables
+#endif
+
+/**
+ * UCB scores of all children of a node, computed in one pass over a structure of arrays
+ * the statistics are gathered as counts and padded to a multiple of 8 lanes, so that
+ * the scores are computed 8 at a time with AVX2 if the CPU supports it, or by a scalar loop otherwise
+ *
+ * the exploration sqrt(log(N) / n) is computed as sqrt(log(N)) * (1 / sqrt(n)), where log(N), and 1 / sqrt(n)
+ * in the scalar loop, are looked up in tables for counts below UCB_TABLE_SIZE and are calculated beyond,
+ * while AVX2 calculates 1 / sqrt(n) of 8 lanes at once, which gives the same correctly rounded results
+ * the scalar loop skips the AMAF blending when RAVE is disabled, so that it costs no more than a plain loop
+ */
+class ucb {
+public:
+	enum { lanes = 8, capacity = (board::size_x * board::size_y + lanes - 1) / lanes * lanes };
+
+	/**
+	 * the statistics of the children, where (win / value) is the exploitation, (visit) is the visit count
+	 * of the edge for the exploration, and (amaf_win / amaf_visit) is the AMAF value
+	 * counts are taken as signed 32-bit integers, which converts to floats faster
+	 */
+	struct batch {
+		alignas(32) int32_t win[capacity], value[capacity], visit[capacity];
+		alignas(32) int32_t amaf_win[capacity], amaf_visit[capacity];
+		int size;
+
+		void clear() { size = 0; }
+		void push(uint32_t w, uint32_t v, uint32_t n, uint32_t aw, uint32_t av) {
+			win[size] = w, value[size] = v, visit[size] = n;
+			amaf_win[size] = aw, amaf_visit[size] = av;
+			size++;
+		}
+	};
+
+	/**
+	 * get log(n) and 1 / sqrt(n) by table lookup, or by calculation beyond the tables
+	 * both return 0 for n == 0
+	 */
+	static float ln(uint32_t n) { return n < UCB_TABLE_SIZE ? tables().ln[n] : std::log(float(n)); }
+	static float rsqrt(uint32_t n) { return n < UCB_TABLE_SIZE ? tables().rsqrt[n] : 1 / std::sqrt(float(n)); }
+
+	/**
+	 * return the index of the child with the highest score, the first one if tied
+	 * an unvisited child scores the highest, and the AMAF value is blended by beta = sqrt(k / (3n + k))
+	 * with n = max(value, visit), where k = 0 disables it
+	 */
+	static int select(batch& b, float log_visit, float c, float k) {
+		if (b.size == 0) return -1;
+#if defined(UCB_AVX2)
+		static const bool avx2 = __builtin_cpu_supports("avx2");
+		if (avx2) return select_avx2(b, std::sqrt(log_visit), c, k);
+#endif
+		float root = std::sqrt(log_visit), high = -std::numeric_limits<float>::max();
+		int pick = 0;
+		for (int i = 0; i < b.size; i++) {
+			float exploit = float(b.win[i]) / b.value[i];
+			if (k != 0 && b.amaf_visit[i] > 0) {
+				float rave = float(b.amaf_win[i]) / b.amaf_visit[i];
+				float beta = std::sqrt(k / (3 * float(std::max(b.value[i], b.visit[i])) + k));
+				exploit = exploit + beta * (rave - exploit);
+			}
+			float s = b.visit[i] != 0 ? exploit + c * (root * rsqrt(b.visit[i])) : std::numeric_limits<float>::max();
+			if (s > high) high = s, pick = i;
+		}
+		return pick;
+	}
+
+protected:
+#if defined(UCB_AVX2)
+	__attribute__((target("avx2")))
+	static int select_avx2(batch& b, float root, float c, float k) {
+		for (int i = b.size; i % lanes; i++) { // padding, whose scores are dropped
+			b.win[i] = b.amaf_win[i] = b.amaf_visit[i] = 0;
+			b.value[i] = b.visit[i] = 1;
+		}
+		alignas(32) float score[capacity];
+		int n = (b.size + lanes - 1) / lanes * lanes;
+		const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1), three = _mm256_set1_ps(3);
+		const __m256 vk = _mm256_set1_ps(k), vc = _mm256_set1_ps(c), vroot = _mm256_set1_ps(root);
+		const __m256 top = _mm256_set1_ps(std::numeric_limits<float>::max()), bottom = _mm256_set1_ps(-std::numeric_limits<float>::max());
+		const __m256i size = _mm256_set1_epi32(b.size);
+		__m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256 best = bottom;
+		for (int i = 0; i < n; i += lanes, index = _mm256_add_epi32(index, _mm256_set1_epi32(lanes))) {
+			__m256 win = _mm256_cvtepi32_ps(_mm256_load_si256((const __m256i*)(b.win + i)));
+			__m256 value = _mm256_cvtepi32_ps(_mm256_load_si256((const __m256i*)(b.value + i)));
+			__m256 visit = _mm256_cvtepi32_ps(_mm256_load_si256((const __m256i*)(b.visit + i)));
+			__m256 amaf_win = _mm256_cvtepi32_ps(_mm256_load_si256((const __m256i*)(b.amaf_win + i)));
+			__m256 amaf = _mm256_cvtepi32_ps(_mm256_load_si256((const __m256i*)(b.amaf_visit + i)));
+			__m256 exploit = _mm256_div_ps(win, value);
+			__m256 rave = _mm256_div_ps(amaf_win, _mm256_max_ps(amaf, one));
+			__m256 count = _mm256_max_ps(value, visit);
+			__m256 beta = _mm256_sqrt_ps(_mm256_div_ps(vk, _mm256_add_ps(_mm256_mul_ps(three, count), vk)));
+			beta = _mm256_and_ps(beta, _mm256_cmp_ps(amaf, zero, _CMP_GT_OQ));
+			exploit = _mm256_add_ps(exploit, _mm256_mul_ps(beta, _mm256_sub_ps(rave, exploit)));
+			__m256 explore = _mm256_mul_ps(vroot, _mm256_div_ps(one, _mm256_sqrt_ps(visit)));
+			__m256 s = _mm256_add_ps(exploit, _mm256_mul_ps(vc, explore));
+			s = _mm256_blendv_ps(s, top, _mm256_cmp_ps(visit, zero, _CMP_EQ_OQ));
+			s = _mm256_blendv_ps(bottom, s, _mm256_castsi256_ps(_mm256_cmpgt_epi32(size, index)));
+			_mm256_store_ps(score + i, s);
+			best = _mm256_max_ps(best, s);
+		}
+		alignas(32) float max[lanes];
+		_mm256_store_ps(max, best);
+		float high = *std::max_element(max, max + lanes);
+		int i = 0;
+		while (i < b.size - 1 && score[i] != high) i++;
+		return i;
+	}
+#endif
+
+private:
+	struct table {
+		std::array<float, UCB_TABLE_SIZE> ln, rsqrt;
+	};
+	static const table& tables() {
+		static const table t = ([]() {
+			table t;
+			t.ln[0] = t.rsqrt[0] = 0;
+			for (size_t n = 1; n < UCB_TABLE_SIZE; n++) {
+				t.ln[n] = std::log(float(n));
+				t.rsqrt[n] = 1 / std::sqrt(float(n));
+			}
+			return t;
+		})();
+		return t;
+	}
+};